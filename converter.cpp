@@ -6,24 +6,28 @@
 /// representation named the literal string is used.
 
 #include <cmath>
+#include <mutex>
+#include <new>
+#include <stdlib.h>
+#include <x86intrin.h>
 
 #include "converter.h"
 
 /// @defgroup domainsizecache Base Subtree Offsets
 /// @{
 
-#define Start0     (DomainSizeCache[(offset-1)*12+0]) 	///< Root of the base subtree '0'
-#define Start1     (DomainSizeCache[(offset-1)*12+1]) 	///< Root of the base subtree '1'
-#define Start3     (DomainSizeCache[(offset-1)*12+3]) 	///< Root of the base subtree '3'
-#define Start7     (DomainSizeCache[(offset-1)*12+7]) 	///< Root and body of the base subtree '7'
-#define Start7_Sub (DomainSizeCache[(offset-1)*12+8]) 	///< Body of the base subtree '3'
-#define Start5     (DomainSizeCache[(offset-1)*12+5]) 	///< Root and body of the base subtree '5'
-#define Start5_Sub (DomainSizeCache[(offset-1)*12+9]) 	///< Body of the base subtree '1'
-#define Start2     (DomainSizeCache[(offset-1)*12+2]) 	///< Root of the base subtree '2'
-#define Start6     (DomainSizeCache[(offset-1)*12+6]) 	///< Root and body of the base subtree '6'
-#define Start6_Sub (DomainSizeCache[(offset-1)*12+10])	///< Body of the base subtree '2'
-#define Start4     (DomainSizeCache[(offset-1)*12+4]) 	///< Root and body of the base subtree '4'
-#define Start4_Sub (DomainSizeCache[(offset-1)*12+11])	///< Body of the base subtree '0'
+#define Start0     (DomainSizeCache[0]) 	///< Root of the base subtree '0'
+#define Start1     (DomainSizeCache[1]) 	///< Root of the base subtree '1'
+#define Start3     (DomainSizeCache[3]) 	///< Root of the base subtree '3'
+#define Start7     (DomainSizeCache[7]) 	///< Root and body of the base subtree '7'
+#define Start7_Sub (DomainSizeCache[8]) 	///< Body of the base subtree '3'
+#define Start5     (DomainSizeCache[5]) 	///< Root and body of the base subtree '5'
+#define Start5_Sub (DomainSizeCache[9]) 	///< Body of the base subtree '1'
+#define Start2     (DomainSizeCache[2]) 	///< Root of the base subtree '2'
+#define Start6     (DomainSizeCache[6]) 	///< Root and body of the base subtree '6'
+#define Start6_Sub (DomainSizeCache[10])	///< Body of the base subtree '2'
+#define Start4     (DomainSizeCache[4]) 	///< Root and body of the base subtree '4'
+#define Start4_Sub (DomainSizeCache[11])	///< Body of the base subtree '0'
 
 /// @}
 
@@ -57,36 +61,6 @@ unsigned int GetMaxDomainDepth(unsigned int TaskSize)
 	return (unsigned int)((TaskSize-1)/3);
 }
 
-/// Shows the equivalent task size for the final simple tree.
-///
-/// After a number of collapses (see GetMaxDomainDepth()) the Knapsack
-/// Packing Tree becomes the final simple tree. Depending on the Task
-/// Size, there are exactly three types of such trees, corresponding to
-/// Task Sizes 3, 2 and 1. Reduction rate is the number of binary variables
-/// missing from the final tree, but present in the base subtree. In other
-/// words, if the reduction rate is 0, then the final tree is isomorphic to
-/// the base subtree with 8 nodes. On reduction level 1 the final tree only
-/// contains 4 nodes, and on level 2 only 2 nodes.
-///
-/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
-///
-/// @returns			The reduction rate of the final tree
-unsigned int GetTopDomainReductionRate(unsigned int TaskSize)
-{
-	// n = 1 --> Reduced (2)
-	// n = 2 --> Reduced (4)
-	// n = 3 --> Full (8)
-	// n = 4 --> Reduced
-	// n = 5 --> Reduced
-	// n = 6 --> Full
-	// n = 7 --> Reduced
-	// n = 8 --> Reduced
-	// n = 9 --> Full
-	// ...
-
-	return 3 * (!!(TaskSize % 3)) - (TaskSize % 3);
-}
-
 /// Shows how many nodes of the initial tree is contained in each node of the collapsed tree
 ///
 /// After each collapse, all the tree nodes become multinodes that hold all the nodes of
@@ -96,9 +70,33 @@ unsigned int GetTopDomainReductionRate(unsigned int TaskSize)
 /// @param	lv	Level: number of collapse operations on the tree;
 ///
 /// @returns		The number of initial nodes (knapsack packings) in each multinode of the tree;
-NTL::ZZ GetDomainSize(unsigned int lv)
+template<typename NodeNumber>
+NodeNumber GetDomainSize(unsigned int lv)
 {
-	return NTL::ZZ((unsigned long long)(pow(2, 3 * lv + 1) - 1));
+	return PowerOfTwo<NodeNumber>(3 * lv + 1) - 1;
+}
+
+/// Takes the digit of one collapse level off the node number.
+///
+/// @param	DomainSizeCache	Base subtree offsets of the collapse level;
+/// @param[in,out]	number	Distance from the root of the level multinode, turns into the one of the digit multinode;
+///
+/// @returns			The digit (base subtree) of the level;
+template<typename NodeNumber>
+static inline DomainType GetDomainDigit(const NodeNumber* DomainSizeCache, NodeNumber& number)
+{
+	if (number < Start1)	{ number -= Start0;			return Domain_Lv0; }
+	if (number < Start3)	{ number -= Start1;			return Domain_Lv1; }
+	if (number < Start7)	{ number -= Start3;			return Domain_Lv3; }
+	if (number < Start7_Sub){ number -= Start7;			return Domain_Lv7; }
+	if (number < Start5)	{ number -= Start7_Sub - 1;	return Domain_Lv3; }
+	if (number < Start5_Sub){ number -= Start5;			return Domain_Lv5; }
+	if (number < Start2)	{ number -= Start5_Sub - 1;	return Domain_Lv1; }
+	if (number < Start6)	{ number -= Start2;			return Domain_Lv2; }
+	if (number < Start6_Sub){ number -= Start6;			return Domain_Lv6; }
+	if (number < Start4)	{ number -= Start6_Sub - 1;	return Domain_Lv2; }
+	if (number < Start4_Sub){ number -= Start4;			return Domain_Lv4; }
+							{ number -= Start4_Sub - 1;	return Domain_Lv0; }
 }
 
 /// Gets the literal string showing the packing vector position in the collapsed trees
@@ -111,40 +109,26 @@ NTL::ZZ GetDomainSize(unsigned int lv)
 /// This function uses the knowledge about domain sizes and the search sequence to convert
 /// the ordinal number of the packing to the corresponding literal tree.
 ///
-/// @pre	Domain Size Cache must be initialized with enough level of collapse. See InitializeDomainSizeCache().
-///
-/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param	ctx		Converter Context for the task size;
 /// @param[out]	e		Memory buffer for the literal string;
 /// @param	number		Ordinal number of the packing vector to convert;
- void GetLiteralStringByNumber(unsigned int TaskSize, DomainType* e, NTL::ZZ number)
+template<typename NodeNumber>
+void GetLiteralStringByNumber(const ConverterContext<NodeNumber>& ctx, DomainType* e, NodeNumber number)
 {
-	unsigned int offset = (unsigned int)(TaskSize / 3) + 1 + !!GetTopDomainReductionRate(TaskSize);
-	//unsigned long long DomainSizeForCurrentOffset = 0;
+	int depth = (int)GetMaxDomainDepth(ctx.GetTaskSize());
+	int lv = depth;
 
 	e[0] = Domain_DOWNMOST;
-	e[offset] = Domain_TOPMOST;
-	e++;
+	e[depth + 2] = Domain_TOPMOST;
 
-	while (offset>1)
-	{
-		//unsigned long long DomainSizeForCurrentOffset = (unsigned long long)pow(2, --offset * 3 - 2) - 1;
-		--offset;
-		NTL::ZZ cursor = NTL::ZZ(0);
-
-		if (number < Start1)	{ number -= Start0;			e[offset - 1] = Domain_Lv0; continue; }
-		if (number < Start3)	{ number -= Start1;			e[offset - 1] = Domain_Lv1; continue; }
-		if (number < Start7)	{ number -= Start3;			e[offset - 1] = Domain_Lv3; continue; }
-		if (number < Start7_Sub){ number -= Start7;			e[offset - 1] = Domain_Lv7; continue; }
-		if (number < Start5)	{ number -= Start7_Sub - 1;	e[offset - 1] = Domain_Lv3; continue; }
-		if (number < Start5_Sub){ number -= Start5;			e[offset - 1] = Domain_Lv5; continue; }
-		if (number < Start2)	{ number -= Start5_Sub - 1;	e[offset - 1] = Domain_Lv1; continue; }
-		if (number < Start6)	{ number -= Start2;			e[offset - 1] = Domain_Lv2; continue; }
-		if (number < Start6_Sub){ number -= Start6;			e[offset - 1] = Domain_Lv6; continue; }
-		if (number < Start4)	{ number -= Start6_Sub - 1;	e[offset - 1] = Domain_Lv2; continue; }
-		if (number < Start4_Sub){ number -= Start4;			e[offset - 1] = Domain_Lv4; continue; }
-								{ number -= Start4_Sub - 1;	e[offset - 1] = Domain_Lv0; }
-	}
-	--e;
+	// The remainder below a level fits into a machine word from MaxNativeDomainLevel down
+	for (; lv >= 0 && (lv == depth || lv > (int)MaxNativeDomainLevel); lv--)
+		e[lv + 1] = GetDomainDigit(ctx.GetDomainLevel(lv), number);
+
+	uint64_t rest;
+	NodeToWords(number, &rest, 1);
+	for (; lv >= 0; lv--)
+		e[lv + 1] = GetDomainDigit(ctx.GetNativeLevel(lv), rest);
 	return;
 }
 
@@ -156,8 +140,6 @@ NTL::ZZ GetDomainSize(unsigned int lv)
  /// known in advance, it is sufficient to know the literal string in order to restore the
  /// binary vector representation.
  ///
- /// @pre	Domain Size Cache must be initialized with enough level of collapse. See InitializeDomainSizeCache().
- ///
  /// @param	 TaskSize	Task Size for the corresponding Knapsack Problem;
  /// @param[out] mask		The memory buffer for the restored binary vector;
  /// @param	 LiteralString	The literal string of the packing in question;
@@ -213,62 +195,139 @@ void SetMaskByLiteralString(unsigned int TaskSize, NTL::vec_GF2* mask, DomainTyp
 	}
 }
 
-/// Executes preliminary calculations, necessary to work with the base subtrees, up to the given collapse level.
+/// Fills the base subtree offsets of one collapse level.
 ///
 /// As the search sequence is known (depth-first traversal) and the number of
 /// packings in each of the nodes of collapsed trees is known (see GetDomainSize())
 /// it is possible to calculate the number of the first node in each of the subtrees.
-/// The more collapses took place, the more data is needed. All the data goes to the
-/// DomainSizeCache static variable, so no return value is present.
+/// Reducers prevent domain start number increment for reduced domains. For example, a
+/// domain with 1st level of reduction does not have 1, 3, 7 and 5 domains, so these
+/// domains point to the same point as the underlying domain 0. Only the top level of
+/// a tree is ever reduced.
 ///
-/// @param	ts	Task Size for the corresponding Knapsack Problem;
-void InitializeDomainSizeCache(unsigned int ts)
+/// @param[out]	DomainSizeCache	Memory buffer of DomainStride entries;
+/// @param	i		Collapse level;
+/// @param	reducer1	0 to drop the domains 1, 3, 7 and 5 (reduction 1 and 2), 1 otherwise;
+/// @param	reducer2	0 to drop the domains 2 and 6 as well (reduction 2), 1 otherwise;
+template<typename NodeNumber>
+static void FillDomainLevel(NodeNumber* DomainSizeCache, int i, int reducer1, int reducer2)
 {
-	if (ts < 3) throw "Unable to use linearization algorithm for n values under 3";
+	DomainSizeCache[0] =		0;
+	DomainSizeCache[1] =		DomainSizeCache[0] + (1)										* reducer1 + 1 * !reducer1;	//Artificial wall
+	DomainSizeCache[3] = 		DomainSizeCache[1] + (1)										* reducer1;
 
-	int depth = GetMaxDomainDepth(ts);
+	DomainSizeCache[7] =		DomainSizeCache[3] + (1)										* reducer1;
+		DomainSizeCache[8] =	DomainSizeCache[7] + (1+(GetDomainSize<NodeNumber>(i)-1) / 2)			* reducer1;
 
-	// Reducers prevent domain start number increment for reduced domains. For example, a domain with 1st level of
-	// reduction does not have 1, 3,7 and 5 domains, so these domain point to the same point as the underlying domain 0.
-	//
+	DomainSizeCache[5] =		DomainSizeCache[7] + (GetDomainSize<NodeNumber>(i))					* reducer1;
+		DomainSizeCache[9] =	DomainSizeCache[5] + (1+(GetDomainSize<NodeNumber>(i)-1) / 2)			* reducer1;
 
-	DomainSizeCache = (NTL::ZZ*)malloc((unsigned long)((depth + 1) * 12 * sizeof(NTL::ZZ) + 6 + 3));
-	if (!DomainSizeCache) throw;
+	DomainSizeCache[2] =		DomainSizeCache[5] + (GetDomainSize<NodeNumber>(i))					* reducer1 * reducer2;	//Artificial wall
 
-	for(unsigned long ii=0;ii<(unsigned long)((depth + 1) * 12 * sizeof(NTL::ZZ) + 6 + 3);ii++)
-	    ((unsigned char*)DomainSizeCache)[ii]=(unsigned char)0;
+	DomainSizeCache[6] =		DomainSizeCache[2] + (1)										* reducer2;
+		DomainSizeCache[10] =	DomainSizeCache[6] + (1+(GetDomainSize<NodeNumber>(i)-1) / 2)			* reducer2;
 
-	for (int i = 0; i <= depth; i++)
-	{
-		int reducer1 = (GetTopDomainReductionRate(ts) >= 1) ? (!(depth==i)) : (1);
-		int reducer2 = (GetTopDomainReductionRate(ts) >= 2) ? (!(depth==i)) : (1);
+	DomainSizeCache[4] =		DomainSizeCache[6] + (GetDomainSize<NodeNumber>(i))					* reducer2;
+		DomainSizeCache[11] =	DomainSizeCache[4] + (1+(GetDomainSize<NodeNumber>(i)-1) / 2);
+	return;
+}
 
-		DomainSizeCache[0 + 12 * i] =		0;
-		DomainSizeCache[1 + 12 * i] =		DomainSizeCache[0 + 12 * i] + (1)											* reducer1 + 1 * !reducer1;	//Artificial wall
-		DomainSizeCache[3 + 12 * i] = 		DomainSizeCache[1 + 12 * i] + (1)													* reducer1;
+/// Allocates a cache-line-aligned level of DomainStride constructed entries.
+template<typename NodeNumber>
+static NodeNumber* AllocateDomainLevel()
+{
+	void* memory = 0;
+	if (posix_memalign(&memory, 64, DomainStride * sizeof(NodeNumber)) != 0) throw "Unable to allocate the Domain Size Cache";
+	NodeNumber* level = (NodeNumber*)memory;
+	for (unsigned int k = 0; k < DomainStride; k++) new (level + k) NodeNumber();
+	return level;
+}
 
-		DomainSizeCache[7 + 12 * i] =		DomainSizeCache[3 + 12 * i] + (1)											* reducer1;
-			DomainSizeCache[8 + 12 * i] =	DomainSizeCache[7 + 12 * i] + (1+(GetDomainSize(i)-1) / 2)					* reducer1;
+/// Shared levels of the given node number type (see DomainLevels)
+template<typename NodeNumber> struct DomainLevelStore
+{
+	static std::mutex Lock;				///< Guards the growth of the table;
+	static std::vector<NodeNumber*> Levels;	///< Levels built so far, the lowest first;
+};
+template<typename NodeNumber> std::mutex DomainLevelStore<NodeNumber>::Lock;
+template<typename NodeNumber> std::vector<NodeNumber*> DomainLevelStore<NodeNumber>::Levels;
 
-		DomainSizeCache[5 + 12 * i] =		DomainSizeCache[7 + 12 * i] + (GetDomainSize(i))							* reducer1;
-			DomainSizeCache[9 + 12 * i] =	DomainSizeCache[5 + 12 * i] + (1+(GetDomainSize(i)-1) / 2)					* reducer1;
+/// Gets the base subtree offsets of an unreduced collapse level, building the missing levels first.
+///
+/// The levels below the top one do not depend on the task size, so they are
+/// built once per node number type and shared by all the contexts. The table
+/// grows lazily by level; a level is never moved or freed once built, so the
+/// pointers handed out stay valid for the whole process.
+///
+/// @param	level	Collapse level;
+///
+/// @returns		DomainStride offsets of the level;
+template<typename NodeNumber>
+const NodeNumber* DomainLevels<NodeNumber>::GetLevel(unsigned int level)
+{
+	std::lock_guard<std::mutex> guard(DomainLevelStore<NodeNumber>::Lock);
+	std::vector<NodeNumber*>& levels = DomainLevelStore<NodeNumber>::Levels;
+	while (levels.size() <= level)
+	{
+		// Level i is below the top for n from 3i + 4 up
+		if (3 * levels.size() + 4 > NodeLimit<NodeNumber>::MaxTaskSize) throw "Node number type is too narrow for the domain level";
+		NodeNumber* next = AllocateDomainLevel<NodeNumber>();
+		FillDomainLevel(next, (int)levels.size(), 1, 1);
+		levels.push_back(next);
+	}
+	return levels[level];
+}
 
-		DomainSizeCache[2 + 12 * i] = DomainSizeCache[5 + 12 * i] + (GetDomainSize(i))									* reducer1 * reducer2;	//Artificial wall
+/// Gathers the base subtree offsets for the task size.
+///
+/// The levels below the top are taken from the shared DomainLevels table (the
+/// ones up to MaxNativeDomainLevel in machine words as well), and only the top
+/// level, reduced whenever 3 does not divide n, is built for the context.
+/// The radix digit table is generated for the digit width: entry h holds the
+/// digit of a group whose k offset bits are h, that is the items whose bits
+/// are clear (item t of the group at bit k-1-t of h, bit t of the digit), and
+/// the number of those items above bit 16. The rank table is its inverse:
+/// entry d holds the offset bits h of digit d and the same item count.
+///
+/// @param	ts	Task Size for the corresponding Knapsack Problem;
+/// @param	rb	Digit width of the radix strings (1 to MaxRadixBits);
+template<typename NodeNumber>
+ConverterContext<NodeNumber>::ConverterContext(unsigned int ts, unsigned int rb) : TaskSize(ts), RadixBits(rb), Top(0)
+{
+	if (ts < 3) throw "Unable to use linearization algorithm for n values under 3";
+	if (ts > NodeLimit<NodeNumber>::MaxTaskSize) throw "Node number type is too narrow for the task size";
+	if (rb < 1 || rb > MaxRadixBits) throw "Radix bits are out of range";
 
-		DomainSizeCache[6 + 12 * i] = DomainSizeCache[2 + 12 * i] + (1)													* reducer2;
-			DomainSizeCache[10 + 12 * i] =	DomainSizeCache[6 + 12 * i] + (1+(GetDomainSize(i)-1) / 2)					* reducer2;
+	RadixTable.resize(1u << rb);
+	RankTable.resize(1u << rb);
+	for (unsigned int h = 0; h < RadixTable.size(); h++)
+	{
+		uint32_t digit = 0;
+		for (unsigned int t = 0; t < rb; t++)
+			if (!((h >> (rb - 1 - t)) & 1)) digit |= 1u << t;
+		RadixTable[h] = digit | (uint32_t)__builtin_popcount(digit) << 16;
+		RankTable[digit] = h | (uint32_t)__builtin_popcount(digit) << 16;
+	}
 
-		DomainSizeCache[4 + 12 * i] = DomainSizeCache[6 + 12 * i] + (GetDomainSize(i))									* reducer2;
-			DomainSizeCache[11 + 12 * i] =	DomainSizeCache[4 + 12 * i] + (1+(GetDomainSize(i)-1) / 2);
+	int depth = GetMaxDomainDepth(ts);
+	for (int i = 0; i < depth; i++)
+	{
+		Levels.push_back(DomainLevels<NodeNumber>::GetLevel(i));
+		if (i <= (int)MaxNativeDomainLevel) NativeLevels.push_back(DomainLevels<uint64_t>::GetLevel(i));
 	}
+
+	Top = AllocateDomainLevel<NodeNumber>();
+	FillDomainLevel(Top, depth, GetTopDomainReductionRate(ts) >= 1 ? 0 : 1, GetTopDomainReductionRate(ts) >= 2 ? 0 : 1);
+	Levels.push_back(Top);
 	return;
 }
 
-/// This function frees up the resources taken by InitializeDomainSizeCache().
-void DeinitializeDomainSizeCache()
+/// This function frees up the top level of the context.
+template<typename NodeNumber>
+ConverterContext<NodeNumber>::~ConverterContext()
 {
-	if (DomainSizeCache) free(DomainSizeCache);
-	return;
+	for (unsigned int k = 0; k < DomainStride; k++) Top[k].~NodeNumber();
+	free(Top);
 }
 
 /// This function builds the literal string for a packing based on its binary vector.
@@ -318,15 +377,17 @@ void GetLiteralStringByMask(unsigned int TaskSize, DomainType* lit, NTL::vec_GF2
 ///
 /// This function reverses the GetLiteralStringByNumber().
 ///
-/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param	ctx		Converter Context for the task size;
 /// @param	lit		The literral string of the packing in question;
 ///
 /// @returns			Ordinal number of the packing in question;
-NTL::ZZ GetNumberByLiteralString(unsigned int TaskSize, DomainType* lit)
+template<typename NodeNumber>
+NodeNumber GetNumberByLiteralString(const ConverterContext<NodeNumber>& ctx, DomainType* lit)
     {
-    NTL::ZZ num; num=0;
+    unsigned int TaskSize = ctx.GetTaskSize();
+    NodeNumber num; num=0;
     for (unsigned int y = 1; lit[y] != Domain_TOPMOST; y++)
-    	 num += GetDomainStartFromLiteralString(lit, y, !!(lit[y+1]==Domain_TOPMOST)*GetTopDomainReductionRate(TaskSize));
+    	 num += GetDomainStartFromLiteralString<NodeNumber>(lit, y, !!(lit[y+1]==Domain_TOPMOST)*GetTopDomainReductionRate(TaskSize));
     return(num);
     }
 
@@ -338,13 +399,14 @@ NTL::ZZ GetNumberByLiteralString(unsigned int TaskSize, DomainType* lit)
 /// @param	ReductionRate	The reduction level for the initail tree (see GetTopDomainReductionLevel());
 ///
 /// @returns			Distance between the given packing and the root of its subtree at given collapse level;
-NTL::ZZ GetDomainStartFromLiteralString(DomainType* LiteralString, unsigned int offset, unsigned int ReductionRate)
+template<typename NodeNumber>
+NodeNumber GetDomainStartFromLiteralString(DomainType* LiteralString, unsigned int offset, unsigned int ReductionRate)
 {
-	if ((LiteralString[offset] == Domain_TOPMOST) || (LiteralString[offset] == Domain_DOWNMOST)) { throw; return NTL::ZZ(0); }
-	NTL::ZZ DomainSizeForCurrentOffset; NTL::power(DomainSizeForCurrentOffset, 2, offset * 3 - 2);
+	if ((LiteralString[offset] == Domain_TOPMOST) || (LiteralString[offset] == Domain_DOWNMOST)) { throw; return NodeNumber(0); }
+	NodeNumber DomainSizeForCurrentOffset = PowerOfTwo<NodeNumber>(offset * 3 - 2);
     DomainSizeForCurrentOffset--;
 	//	unsigned long long DomainSizeForIncreasedOffset = DomainSizeForCurrentOffset * 8 + 7;
-	NTL::ZZ ret; ret = 0;
+	NodeNumber ret; ret = 0;
 
 	DomainType curr = LiteralString[offset + 0];
 	DomainType next = LiteralString[offset - 1];
@@ -429,3 +491,626 @@ NTL::ZZ GetDomainStartFromLiteralString(DomainType* LiteralString, unsigned int
 	}
 	return(ret);
 }
+
+/// @defgroup packedmasks Packed Mask Rank and Unrank
+/// @{
+
+/// Converts the packing vector into the packed mask.
+///
+/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param[out]	packed		Memory buffer of GetPackedMaskSize() words;
+/// @param	mask		The binary vector of the packing;
+void PackMask(unsigned int TaskSize, uint64_t* packed, const NTL::vec_GF2& mask)
+{
+	memset(packed, 0, GetPackedMaskSize(TaskSize) * sizeof(uint64_t));
+	for (unsigned int i = 0; i < TaskSize; i++)
+		if (mask[i] == 1)
+		{
+			unsigned int b = TaskSize - 1 - i;
+			packed[b >> 6] |= 1ULL << (b & 63);
+		}
+	return;
+}
+
+/// Converts the packed mask back into the packing vector.
+///
+/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param[out]	mask		The binary vector of TaskSize elements;
+/// @param	packed		The packed mask;
+void UnpackMask(unsigned int TaskSize, NTL::vec_GF2* mask, const uint64_t* packed)
+{
+	for (unsigned int i = 0; i < TaskSize; i++)
+	{
+		unsigned int b = TaskSize - 1 - i;
+		(*mask)[i] = NTL::GF2((packed[b >> 6] >> (b & 63)) & 1);
+	}
+	return;
+}
+
+/// Gets the number of set bits in (a + k), where the carry out of the top word counts as a bit.
+static unsigned int PopCountPlus(const uint64_t* a, unsigned int words, uint64_t k)
+{
+	unsigned int ret = 0;
+	uint64_t carry = k;
+	for (unsigned int i = 0; i < words; i++)
+	{
+		uint64_t s = a[i] + carry;
+		carry = s < carry;
+		ret += __builtin_popcountll(s);
+	}
+	return ret + (unsigned int)carry;
+}
+
+/// Gets the ordinal number of the packing given by its packed mask.
+///
+/// The root is node 0. Each item i added to a packing whose last item
+/// precedes it skips the subtrees of all the items between, that is the sum
+/// of 2^(n-1-j) for j between them. Summed over all the items of the packing,
+/// this telescopes into k + 2^n - M - lowbit(M).
+///
+/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param	packed		The packed mask of the packing in question;
+///
+/// @returns			Ordinal number of the packing in question;
+template<typename NodeNumber>
+NodeNumber GetNumberByPackedMask(unsigned int TaskSize, const uint64_t* packed)
+{
+	unsigned int words = GetPackedMaskSize(TaskSize);
+	unsigned int k = 0, low = 0;
+	for (unsigned int i = 0; i < words; i++) k += __builtin_popcountll(packed[i]);
+	if (k == 0) return NodeFromWords<NodeNumber>(packed, words);
+	while (packed[low] == 0) low++;
+
+	NodeNumber ret = PowerOfTwo<NodeNumber>(TaskSize);
+	ret -= NodeFromWords<NodeNumber>(packed, words);
+	ret -= PowerOfTwo<NodeNumber>(64 * low + __builtin_ctzll(packed[low]));
+	ret += (long)k;
+	return ret;
+}
+
+/// Gets the packed mask of the packing by its ordinal number.
+///
+/// Reverses GetNumberByPackedMask(): with D = 2^n - number, the item count
+/// k is the least one for which D + k has no more than k set bits; then
+/// M + lowbit(M) = D + k fixes the mask as M = D + k - 2^t, where
+/// t = popcount(D + k) - 1 + ctz(D + k) - k. The search for k takes
+/// O(log n) passes over the words.
+///
+/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param[out]	packed		Memory buffer of GetPackedMaskSize() words;
+/// @param	number		Ordinal number of the packing to convert;
+template<typename NodeNumber>
+void GetPackedMaskByNumber(unsigned int TaskSize, uint64_t* packed, const NodeNumber& number)
+{
+	unsigned int words = GetPackedMaskSize(TaskSize);
+	NodeToWords(number, packed, words);
+
+	bool root = true;
+	for (unsigned int i = 0; i < words; i++) root &= (packed[i] == 0);
+	if (root) return;
+
+	// D = 2^n - number (the carry beyond 2^n is dropped with n = 64*words)
+	unsigned char borrow = 0;
+	for (unsigned int i = 0; i < words; i++)
+	{
+		unsigned long long top = (i == (TaskSize >> 6)) ? 1ULL << (TaskSize & 63) : 0;
+		unsigned long long r;
+		borrow = _subborrow_u64(borrow, top, packed[i], &r);
+		packed[i] = r;
+	}
+
+	// The least k with popcount(D + k) <= k
+	uint64_t lo = 1, hi = TaskSize;
+	while (lo < hi)
+	{
+		uint64_t mid = (lo + hi) / 2;
+		if (PopCountPlus(packed, words, mid) <= mid) hi = mid;
+		else lo = mid + 1;
+	}
+	uint64_t k = lo;
+
+	// Z = D + k, possibly 2^(64*words) when the mask is a single item 0 of a full word
+	unsigned int pop = PopCountPlus(packed, words, k);
+	unsigned char carry = 0;
+	for (unsigned int i = 0; i < words; i++)
+	{
+		unsigned long long r;
+		carry = _addcarry_u64(carry, packed[i], i == 0 ? k : 0, &r);
+		packed[i] = r;
+	}
+	unsigned int low = 0;
+	while (low < words && packed[low] == 0) low++;
+	unsigned int tz = (low < words) ? 64 * low + __builtin_ctzll(packed[low]) : 64 * words;
+
+	// M = Z - 2^t
+	unsigned int t = pop - 1 + tz - (unsigned int)k;
+	borrow = 0;
+	for (unsigned int i = 0; i < words; i++)
+	{
+		unsigned long long r;
+		borrow = _subborrow_u64(borrow, packed[i], (i == (t >> 6)) ? 1ULL << (t & 63) : 0, &r);
+		packed[i] = r;
+	}
+	return;
+}
+
+/// Gets the number of set bits of a node number.
+template<typename NodeNumber> static inline unsigned int GetNodePopCount(const NodeNumber& a)
+{
+	unsigned int ret = 0;
+	for (unsigned int i = 0; i < sizeof(a) / 8; i++) ret += __builtin_popcountll((uint64_t)(a >> (64 * i)));
+	return ret;
+}
+static inline unsigned int GetNodePopCount(const NTL::ZZ& a) { return (unsigned int)NTL::weight(a); }
+
+/// Gets the number of trailing zero bits of a nonzero node number.
+template<typename NodeNumber> static inline unsigned int GetNodeTrailingZeros(const NodeNumber& a)
+{
+	for (unsigned int i = 0; i < sizeof(a) / 8; i++)
+		if ((uint64_t)(a >> (64 * i))) return 64 * i + __builtin_ctzll((uint64_t)(a >> (64 * i)));
+	return 8 * sizeof(a);
+}
+static inline unsigned int GetNodeTrailingZeros(const NTL::ZZ& a) { return (unsigned int)NTL::NumTwos(a); }
+
+/// Gets the node count of the subtree rooted at the given node.
+///
+/// The size is lowbit(M) = 2^t of GetPackedMaskByNumber(), found the same
+/// way in the node number type itself: no mask is built, and for the
+/// machine word node numbers nothing is allocated.
+///
+/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param	number		Ordinal number of the subtree root;
+///
+/// @returns			Node count of the subtree, 2^n for the root;
+template<typename NodeNumber>
+NodeNumber GetSubtreeSizeByNumber(unsigned int TaskSize, const NodeNumber& number)
+{
+	NodeNumber d = PowerOfTwo<NodeNumber>(TaskSize);
+	if (number == 0) return d;
+	d -= number;
+
+	// The least k with popcount(D + k) <= k, then t from Z = D + k
+	unsigned int lo = 1, hi = TaskSize;
+	NodeNumber z;
+	while (lo < hi)
+	{
+		unsigned int mid = (lo + hi) / 2;
+		z = d + (long)mid;
+		if (GetNodePopCount(z) <= mid) hi = mid;
+		else lo = mid + 1;
+	}
+	z = d + (long)lo;
+	return PowerOfTwo<NodeNumber>(GetNodePopCount(z) - 1 + GetNodeTrailingZeros(z) - lo);
+}
+
+/// Gets the ordinal number of the first node past the subtree of the given one.
+///
+/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param	number		Ordinal number of the subtree root;
+///
+/// @returns			Ordinal number of the next sibling of the node or of its nearest ancestor having one (2^n past the last node);
+template<typename NodeNumber>
+NodeNumber GetNextSiblingByNumber(unsigned int TaskSize, const NodeNumber& number)
+{
+	return number + GetSubtreeSizeByNumber(TaskSize, number);
+}
+
+/// Splits a node range into the fewest whole subtrees.
+///
+/// The subtree of a node holds the node and the 2^h - 1 nodes right after it,
+/// h being n - 1 minus its last item. The subtrees are nested, so the range is
+/// covered greedily from the left: each node takes its whole subtree when the
+/// subtree fits into the rest of the range, and is taken alone otherwise. A
+/// node taken alone is an ancestor of all the rest of the range, so a lone
+/// node is only followed by its own descendants. The pieces number no more
+/// than n(n-1)/2 + 1 (the siblings of every ancestor of the first node). The
+/// first node is unranked through the radix digit table of the context. The
+/// pieces are unranked and stepped in place at the end of the roots vector, so
+/// nothing is allocated once its capacity holds them all.
+///
+/// @param	ctx		Converter context for the task size;
+/// @param	first		Ordinal number of the first node of the range;
+/// @param	last		Ordinal number of the last node of the range (not below first);
+/// @param[out]	roots		Receives the packed masks of the subtree roots, GetPackedMaskSize() words each;
+/// @param[out]	depths		Receives the subtree heights h (0 for a node taken alone or a leaf);
+template<typename NodeNumber>
+void SplitNodeRange(const ConverterContext<NodeNumber>& ctx, const NodeNumber& first, const NodeNumber& last,
+                    std::vector<uint64_t>* roots, std::vector<unsigned int>* depths)
+{
+	unsigned int TaskSize = ctx.GetTaskSize();
+	unsigned int words = GetPackedMaskSize(TaskSize);
+	roots->resize(words);
+	GetPackedMaskByRadix(ctx, roots->data(), first);
+	depths->clear();
+
+	NodeNumber left = last - first;		// Nodes of the range after the current one
+	NodeNumber rest;			// Nodes of the current subtree after its root
+	while (true)
+	{
+		uint64_t* packed = roots->data() + roots->size() - words;
+		unsigned int h = TaskSize - 1 - GetLastPackedItem(TaskSize, packed);
+		rest = PowerOfTwo<NodeNumber>(h) - 1;
+		if (left < rest)
+		{
+			// The subtree runs past the range: the node alone, then its first child
+			depths->push_back(0);
+			if (left == 0) break;
+			left -= 1;
+			roots->resize(roots->size() + words);
+			packed = roots->data() + roots->size() - words;
+			memcpy(packed, packed - words, words * sizeof(uint64_t));
+			FlipPackedItem(TaskSize, packed, TaskSize - h);
+			continue;
+		}
+		depths->push_back(h);
+		if (left == rest) break;
+		left -= rest + 1;
+		roots->resize(roots->size() + words);
+		packed = roots->data() + roots->size() - words;
+		memcpy(packed, packed - words, words * sizeof(uint64_t));
+		SkipPackedBranch(TaskSize, packed);
+	}
+	return;
+}
+
+/// @}
+
+/// @defgroup radixstrings Radix Strings
+/// @{
+
+/// Converts the radix string into the packed mask.
+///
+/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param	RadixBits	Digit width k of the radix string;
+/// @param[out]	packed		Memory buffer of GetPackedMaskSize() words;
+/// @param	digits		The radix string, ceil(n / k) digits, top group first;
+void SetPackedMaskByRadixString(unsigned int TaskSize, unsigned int RadixBits, uint64_t* packed, const uint16_t* digits)
+{
+	unsigned int groups = (TaskSize + RadixBits - 1) / RadixBits;
+	unsigned int pad = groups * RadixBits - TaskSize;
+	memset(packed, 0, GetPackedMaskSize(TaskSize) * sizeof(uint64_t));
+	for (unsigned int g = 0; g < groups; g++)
+		for (unsigned int d = digits[g]; d; d &= d - 1)
+		{
+			unsigned int item = RadixBits * g + __builtin_ctz(d) - pad;
+			unsigned int b = TaskSize - 1 - item;
+			packed[b >> 6] |= 1ULL << (b & 63);
+		}
+	return;
+}
+
+/// Converts the packed mask into the radix string.
+///
+/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param	RadixBits	Digit width k of the radix string;
+/// @param[out]	digits		Memory buffer of ceil(n / k) digits;
+/// @param	packed		The packed mask of the packing;
+void GetRadixStringByPackedMask(unsigned int TaskSize, unsigned int RadixBits, uint16_t* digits, const uint64_t* packed)
+{
+	unsigned int groups = (TaskSize + RadixBits - 1) / RadixBits;
+	unsigned int pad = groups * RadixBits - TaskSize;
+	memset(digits, 0, groups * sizeof(uint16_t));
+	for (unsigned int i = 0; i < TaskSize; i++)
+		if (GetPackedItem(TaskSize, packed, i))
+			digits[(i + pad) / RadixBits] |= 1u << ((i + pad) % RadixBits);
+	return;
+}
+
+/// Checks whether the low bits of a multiword number, below the given bit, make no less than k.
+static bool LowBitsReach(const uint64_t* c, unsigned int bits, unsigned int k)
+{
+	unsigned int full = bits >> 6;
+	uint64_t top = (bits & 63) ? c[full] & ((1ULL << (bits & 63)) - 1) : 0;
+	if (full == 0) return top >= k;
+	if (top) return true;
+	for (unsigned int i = full - 1; i > 0; i--)
+		if (c[i]) return true;
+	return c[0] >= k;
+}
+
+/// Checks whether any of the bits of a multiword number below the given bit is set.
+static inline bool LowBitsSet(const uint64_t* c, unsigned int bits)
+{
+	return LowBitsReach(c, bits, 1);
+}
+
+/// Walks the items from the top with the offset in the packed mask buffer (see the header).
+///
+/// The offset bits of the items decided so far are clear, so the items taken
+/// are set in their place; the borrows of the offset never reach them, as a
+/// whole group is only taken while the offset below it is at least k.
+///
+/// @param	ctx		Converter context for the task size;
+/// @param[out]	packed		Memory buffer of GetPackedMaskSize() words;
+/// @param[out]	digits		Memory buffer of GetRadixStringSize() digits, or 0;
+/// @param	number		Ordinal number of the packing to convert;
+template<typename NodeNumber>
+static void UnrankByRadixTable(const ConverterContext<NodeNumber>& ctx, uint64_t* packed, uint16_t* digits, const NodeNumber& number)
+{
+	unsigned int n = ctx.GetTaskSize(), k = ctx.GetRadixBits();
+	unsigned int groups = ctx.GetRadixStringSize();
+	unsigned int pad = groups * k - n;
+	unsigned int words = GetPackedMaskSize(n);
+	if (digits) memset(digits, 0, groups * sizeof(uint16_t));
+
+	// c = number - 1, the offset among the branches of the items left (none for the root)
+	uint64_t* c = packed;
+	NodeToWords(number, c, words);
+	if (!LowBitsSet(c, n)) return;
+	for (unsigned int i = 0; i < words && c[i]-- == 0; i++);
+
+	unsigned int j = 0;
+	while (j < n)
+	{
+		unsigned int low = n - 1 - j;	// Bit of c for item j
+		if ((j + pad) % k == 0 && low + 1 >= k && LowBitsReach(c, low + 1 - k, k))
+		{
+			// Whole group: take its k offset bits off c, then the items it holds
+			unsigned int b = low + 1 - k, w = b >> 6, s = b & 63;
+			uint64_t h = c[w] >> s;
+			if (s + k > 64) h |= c[w + 1] << (64 - s);
+			h &= (1ULL << k) - 1;
+			c[w] &= ~(((1ULL << k) - 1) << s);
+			if (s + k > 64) c[w + 1] &= ~(((1ULL << k) - 1) >> (64 - s));
+
+			uint32_t entry = ctx.GetRadixEntry((unsigned int)h);
+			if (digits) digits[(j + pad) / k] = (uint16_t)entry;
+			unsigned char borrow = _subborrow_u64(0, c[0], entry >> 16, (unsigned long long*)&c[0]);
+			for (unsigned int i = 1; borrow && i < words; i++)
+				borrow = _subborrow_u64(borrow, c[i], 0, (unsigned long long*)&c[i]);
+			for (uint32_t d = entry & 0xffff; d; d &= d - 1)
+			{
+				unsigned int bit = low - __builtin_ctz(d);
+				c[bit >> 6] |= 1ULL << (bit & 63);
+			}
+			j += k;
+			continue;
+		}
+
+		// Single item: skip it when its bit is set, take it otherwise
+		uint64_t& cw = c[low >> 6];
+		uint64_t bit = 1ULL << (low & 63);
+		if (cw & bit) { cw &= ~bit; j++; continue; }
+		cw |= bit;
+		if (digits) digits[(j + pad) / k] |= 1u << ((j + pad) % k);
+
+		if (!LowBitsSet(c, low)) break;
+		for (unsigned int i = 0; i < words && c[i]-- == 0; i++);
+		j++;
+	}
+	return;
+}
+
+/// This function builds the radix string for a packing based on its ordinal number.
+///
+/// The item groups aligned to the radix are decided by one digit table lookup
+/// each, while the offset left below the group is at least k; the items in
+/// front of the first aligned group and the last few items, where the walk
+/// may stop within a group, are decided one by one (see the header).
+///
+/// @param	ctx		Converter context for the task size;
+/// @param[out]	digits		Memory buffer of GetRadixStringSize() digits;
+/// @param[out]	packed		Memory buffer of GetPackedMaskSize() words: the work area, receives the packed mask;
+/// @param	number		Ordinal number of the packing to convert;
+template<typename NodeNumber>
+void GetRadixStringByNumber(const ConverterContext<NodeNumber>& ctx, uint16_t* digits, uint64_t* packed, const NodeNumber& number)
+{
+	UnrankByRadixTable(ctx, packed, digits, number);
+	return;
+}
+
+/// Gets the packed mask of the packing by its ordinal number through the radix digit table.
+///
+/// @param	ctx		Converter context for the task size;
+/// @param[out]	packed		Memory buffer of GetPackedMaskSize() words;
+/// @param	number		Ordinal number of the packing to convert;
+template<typename NodeNumber>
+void GetPackedMaskByRadix(const ConverterContext<NodeNumber>& ctx, uint64_t* packed, const NodeNumber& number)
+{
+	UnrankByRadixTable(ctx, packed, (uint16_t*)0, number);
+	return;
+}
+
+/// Gets the ordinal number of the packing given by its radix string.
+///
+/// The number is the count of the items taken plus the subtree sizes of the
+/// items skipped before the last one taken. Every group above the last one
+/// holding an item adds its offset bits and item count by one rank table
+/// lookup; the partial top group and the last group go item by item.
+///
+/// @param	ctx		Converter context for the task size;
+/// @param	digits		The radix string of the packing in question;
+///
+/// @returns			Ordinal number of the packing in question;
+template<typename NodeNumber>
+NodeNumber GetNumberByRadixString(const ConverterContext<NodeNumber>& ctx, const uint16_t* digits)
+{
+	unsigned int n = ctx.GetTaskSize(), k = ctx.GetRadixBits();
+	int groups = (int)ctx.GetRadixStringSize();
+	unsigned int pad = groups * k - n;
+	NodeNumber ret; ret = 0;
+
+	int top = groups - 1;
+	while (top >= 0 && digits[top] == 0) top--;
+	for (int g = 0; g <= top; g++)
+	{
+		unsigned int from = g == 0 ? pad : 0;
+		unsigned int to = g == top ? 32 - __builtin_clz(digits[g]) : k;
+		if (from == 0 && to == k)
+		{
+			uint32_t entry = ctx.GetRankEntry(digits[g]);
+			ret += PowerOfTwo<NodeNumber>(n + pad - k * (g + 1)) * (long)(entry & 0xffff);
+			ret += (long)(entry >> 16);
+			continue;
+		}
+		for (unsigned int t = from; t < to; t++)
+			if ((digits[g] >> t) & 1) ret += 1;
+			else ret += PowerOfTwo<NodeNumber>(n - 1 - (k * g + t - pad));
+	}
+	return ret;
+}
+
+/// @}
+
+/// @defgroup packedliterals Packed Literal Strings
+/// @{
+
+/// Packs the literal string.
+///
+/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param[out]	plit		Memory buffer of GetPackedLiteralSize() words;
+/// @param	lit		The literal string, sentinels included;
+void PackLiteralString(unsigned int TaskSize, uint64_t* plit, const DomainType* lit)
+{
+	unsigned int len = GetPackedLiteralLength(TaskSize);
+	memset(plit, 0, GetPackedLiteralSize(TaskSize) * sizeof(uint64_t));
+	for (unsigned int l = 0; l < len; l++)
+		plit[l / PackedLiteralDigits] |= (uint64_t)lit[l + 1] << (3 * (l % PackedLiteralDigits));
+	return;
+}
+
+/// Unpacks the literal string.
+///
+/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param[out]	lit		Memory buffer of GetPackedLiteralLength() + 2 digits, sentinels included;
+/// @param	plit		The packed literal string;
+void UnpackLiteralString(unsigned int TaskSize, DomainType* lit, const uint64_t* plit)
+{
+	unsigned int len = GetPackedLiteralLength(TaskSize);
+	lit[0] = Domain_DOWNMOST;
+	for (unsigned int l = 0; l < len; l++) lit[l + 1] = (DomainType)GetPackedLiteralDigit(plit, l);
+	lit[len + 1] = Domain_TOPMOST;
+	return;
+}
+
+/// Converts the packed literal string into the packed mask.
+///
+/// Word w of the literal string holds the mask bits 63w to 63w + 62, so each
+/// word takes one digit reversal and lands on at most two mask words.
+///
+/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param[out]	packed		Memory buffer of GetPackedMaskSize() words;
+/// @param	plit		The packed literal string of the packing;
+void SetPackedMaskByPackedLiteral(unsigned int TaskSize, uint64_t* packed, const uint64_t* plit)
+{
+	unsigned int words = GetPackedMaskSize(TaskSize);
+	memset(packed, 0, words * sizeof(uint64_t));
+	for (unsigned int w = 0; w < GetPackedLiteralSize(TaskSize); w++)
+	{
+		uint64_t r = ReverseLiteralDigits(plit[w]);
+		unsigned int b = 3 * PackedLiteralDigits * w, q = b >> 6, s = b & 63;
+		packed[q] |= r << s;
+		if (s > 1 && q + 1 < words) packed[q + 1] |= r >> (64 - s);
+	}
+	return;
+}
+
+/// Converts the packed mask into the packed literal string.
+///
+/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param[out]	plit		Memory buffer of GetPackedLiteralSize() words;
+/// @param	packed		The packed mask of the packing;
+void GetPackedLiteralByPackedMask(unsigned int TaskSize, uint64_t* plit, const uint64_t* packed)
+{
+	unsigned int words = GetPackedMaskSize(TaskSize);
+	for (unsigned int w = 0; w < GetPackedLiteralSize(TaskSize); w++)
+	{
+		unsigned int b = 3 * PackedLiteralDigits * w, q = b >> 6, s = b & 63;
+		uint64_t x = packed[q] >> s;
+		if (s > 1 && q + 1 < words) x |= packed[q + 1] << (64 - s);
+		plit[w] = ReverseLiteralDigits(x & ~(1ULL << 63));
+	}
+	return;
+}
+
+/// Converts the packed literal string into the packing vector.
+///
+/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param[out]	mask		The binary vector of TaskSize elements;
+/// @param	plit		The packed literal string of the packing;
+void SetMaskByPackedLiteral(unsigned int TaskSize, NTL::vec_GF2* mask, const uint64_t* plit)
+{
+	std::vector<uint64_t> packed(GetPackedMaskSize(TaskSize));
+	SetPackedMaskByPackedLiteral(TaskSize, packed.data(), plit);
+	UnpackMask(TaskSize, mask, packed.data());
+	return;
+}
+
+/// Converts the packing vector into the packed literal string.
+///
+/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param[out]	plit		Memory buffer of GetPackedLiteralSize() words;
+/// @param	mask		The binary vector of the packing;
+void GetPackedLiteralByMask(unsigned int TaskSize, uint64_t* plit, const NTL::vec_GF2& mask)
+{
+	std::vector<uint64_t> packed(GetPackedMaskSize(TaskSize));
+	PackMask(TaskSize, packed.data(), mask);
+	GetPackedLiteralByPackedMask(TaskSize, plit, packed.data());
+	return;
+}
+
+/// Gets the packed literal string of the packing by its ordinal number, as GetLiteralStringByNumber() does.
+///
+/// @param	ctx		Converter Context for the task size;
+/// @param[out]	plit		Memory buffer of GetPackedLiteralSize() words;
+/// @param	number		Ordinal number of the packing vector to convert;
+template<typename NodeNumber>
+void GetPackedLiteralByNumber(const ConverterContext<NodeNumber>& ctx, uint64_t* plit, NodeNumber number)
+{
+	int depth = (int)GetMaxDomainDepth(ctx.GetTaskSize());
+	int lv = depth;
+	memset(plit, 0, GetPackedLiteralSize(ctx.GetTaskSize()) * sizeof(uint64_t));
+
+	#define PutDigit(digit) (plit[lv / PackedLiteralDigits] |= (uint64_t)(digit) << (3 * (lv % PackedLiteralDigits)))
+	for (; lv >= 0 && (lv == depth || lv > (int)MaxNativeDomainLevel); lv--)
+		PutDigit(GetDomainDigit(ctx.GetDomainLevel(lv), number));
+
+	uint64_t rest;
+	NodeToWords(number, &rest, 1);
+	for (; lv >= 0; lv--)
+		PutDigit(GetDomainDigit(ctx.GetNativeLevel(lv), rest));
+	#undef PutDigit
+	return;
+}
+
+/// Gets the ordinal number of the packing given by its packed literal string.
+///
+/// @param	ctx		Converter Context for the task size;
+/// @param	plit		The packed literal string of the packing in question;
+///
+/// @returns			Ordinal number of the packing in question;
+template<typename NodeNumber>
+NodeNumber GetNumberByPackedLiteral(const ConverterContext<NodeNumber>& ctx, const uint64_t* plit)
+{
+	std::vector<uint64_t> packed(GetPackedMaskSize(ctx.GetTaskSize()));
+	SetPackedMaskByPackedLiteral(ctx.GetTaskSize(), packed.data(), plit);
+	return GetNumberByPackedMask<NodeNumber>(ctx.GetTaskSize(), packed.data());
+}
+
+/// @}
+
+/// @defgroup nodetypes Node Number Type Instantiations
+/// @{
+
+#define INSTANTIATE_CONVERTER(NodeNumber) \
+	template class DomainLevels<NodeNumber>; \
+	template class ConverterContext<NodeNumber>; \
+	template void GetLiteralStringByNumber<NodeNumber>(const ConverterContext<NodeNumber>&, DomainType*, NodeNumber); \
+	template NodeNumber GetDomainStartFromLiteralString<NodeNumber>(DomainType*, unsigned int, unsigned int); \
+	template NodeNumber GetNumberByLiteralString<NodeNumber>(const ConverterContext<NodeNumber>&, DomainType*); \
+	template NodeNumber GetNumberByPackedMask<NodeNumber>(unsigned int, const uint64_t*); \
+	template void GetPackedMaskByNumber<NodeNumber>(unsigned int, uint64_t*, const NodeNumber&); \
+	template NodeNumber GetSubtreeSizeByNumber<NodeNumber>(unsigned int, const NodeNumber&); \
+	template NodeNumber GetNextSiblingByNumber<NodeNumber>(unsigned int, const NodeNumber&); \
+	template void SplitNodeRange<NodeNumber>(const ConverterContext<NodeNumber>&, const NodeNumber&, const NodeNumber&, std::vector<uint64_t>*, std::vector<unsigned int>*); \
+	template void GetRadixStringByNumber<NodeNumber>(const ConverterContext<NodeNumber>&, uint16_t*, uint64_t*, const NodeNumber&); \
+	template void GetPackedMaskByRadix<NodeNumber>(const ConverterContext<NodeNumber>&, uint64_t*, const NodeNumber&); \
+	template NodeNumber GetNumberByRadixString<NodeNumber>(const ConverterContext<NodeNumber>&, const uint16_t*); \
+	template void GetPackedLiteralByNumber<NodeNumber>(const ConverterContext<NodeNumber>&, uint64_t*, NodeNumber); \
+	template NodeNumber GetNumberByPackedLiteral<NodeNumber>(const ConverterContext<NodeNumber>&, const uint64_t*);
+
+INSTANTIATE_CONVERTER(uint64_t)
+INSTANTIATE_CONVERTER(uint128_t)
+INSTANTIATE_CONVERTER(NTL::ZZ)
+
+/// @}
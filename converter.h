@@ -3,11 +3,17 @@
 
 //#include "definitions.h"
 
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
 #include <NTL/ZZ.h>
 #include <NTL/vec_GF2.h>
 #include <NTL/vec_ZZ.h>
 #include <NTL/GF2.h>
 
+#include "fixedint.h"
+
 // Octal domains are as follows:
 // 0,1,3,7,5,2,6,4
 //-------------------------------------
@@ -108,7 +114,50 @@ enum DomainType
 	Domain_DOWNMOST = -2
 };
 
-static NTL::ZZ* DomainSizeCache = 0;	///< This variable contains a pointer to the Domain Size Cache when it is initialized.
+// Node Number Types
+//
+// Node numbers vary from 0 to 2 to the power of n. Whenever they fit
+// into a machine word, native arithmetic is used instead of NTL::ZZ:
+// uint64_t for n <= 63, uint128_t for n <= 127 and NTL::ZZ above.
+
+typedef unsigned __int128 uint128_t;
+
+/// The largest task size whose node numbers (up to 2^n) fit into the given type
+template<typename NodeNumber> struct NodeLimit { static const unsigned int MaxTaskSize = sizeof(NodeNumber) * 8 - 1; };
+template<> struct NodeLimit<NTL::ZZ> { static const unsigned int MaxTaskSize = ~0u; };
+
+/// Returns 2 to the power of e in the given node number type
+template<typename NodeNumber> inline NodeNumber PowerOfTwo(unsigned int e) { return (NodeNumber)1 << e; }
+template<> inline NTL::ZZ PowerOfTwo<NTL::ZZ>(unsigned int e) { return NTL::power2_ZZ(e); }
+
+/// Converts a node number to NTL::ZZ
+template<typename NodeNumber> inline NTL::ZZ NodeToZZ(const NodeNumber& a) { return NTL::ZZFromBytes((const unsigned char*)&a, sizeof(a)); }
+inline NTL::ZZ NodeToZZ(const NTL::ZZ& a) { return a; }
+
+/// Converts a node number to NTL::ZZ in place (allocates nothing once x has room for the number)
+template<typename NodeNumber> inline void NodeToZZ(NTL::ZZ& x, const NodeNumber& a) { NTL::ZZFromBytes(x, (const unsigned char*)&a, sizeof(a)); }
+inline void NodeToZZ(NTL::ZZ& x, const NTL::ZZ& a) { x = a; }
+
+/// Converts a non-negative NTL::ZZ to a node number (truncating to the type width)
+template<typename NodeNumber> inline NodeNumber NodeFromZZ(const NTL::ZZ& a) { NodeNumber r; NTL::BytesFromZZ((unsigned char*)&r, a, sizeof(r)); return r; }
+template<> inline NTL::ZZ NodeFromZZ<NTL::ZZ>(const NTL::ZZ& a) { return a; }
+
+/// Copies a node number into little-endian 64-bit words (truncating to their width)
+template<typename NodeNumber> inline void NodeToWords(const NodeNumber& a, uint64_t* words, unsigned int count)
+{
+	memset(words, 0, count * sizeof(uint64_t));
+	memcpy(words, &a, sizeof(a) < count * sizeof(uint64_t) ? sizeof(a) : count * sizeof(uint64_t));
+}
+inline void NodeToWords(const NTL::ZZ& a, uint64_t* words, unsigned int count) { NTL::BytesFromZZ((unsigned char*)words, a, count * sizeof(uint64_t)); }
+
+/// Makes a node number of little-endian 64-bit words (truncating to the type width)
+template<typename NodeNumber> inline NodeNumber NodeFromWords(const uint64_t* words, unsigned int count)
+{
+	NodeNumber r = 0;
+	memcpy(&r, words, sizeof(r) < count * sizeof(uint64_t) ? sizeof(r) : count * sizeof(uint64_t));
+	return r;
+}
+template<> inline NTL::ZZ NodeFromWords<NTL::ZZ>(const uint64_t* words, unsigned int count) { return NTL::ZZFromBytes((const unsigned char*)words, count * sizeof(uint64_t)); }
 
 // This function returns the maximum octal domain level applicable
 // for the given task size
@@ -121,7 +170,16 @@ unsigned int GetMaxDomainDepth(unsigned int TaskSize);
 // Reduction 0: 0,1,3,7,5,2,6,4
 // Reduction 1: 0,        2,6,4
 // Reduction 2: 0,            4
-unsigned int GetTopDomainReductionRate(unsigned int TaskSize);
+// The literal string stepping below takes it on every step, so it is inline.
+inline unsigned int GetTopDomainReductionRate(unsigned int TaskSize)
+{
+	// n = 1 --> Reduced (2)
+	// n = 2 --> Reduced (4)
+	// n = 3 --> Full (8)
+	// n = 4 --> Reduced
+	// ...
+	return 3 * (!!(TaskSize % 3)) - (TaskSize % 3);
+}
 
 // Mask <-> Number Transitions
 //
@@ -129,13 +187,447 @@ unsigned int GetTopDomainReductionRate(unsigned int TaskSize);
 // between node order (1 for the first node to be examined, 127 for the 127th)
 // That provides for treating all the nodes as a linear pool.
 
+// The node number functions are instantiated for uint64_t, uint128_t and NTL::ZZ.
+// They take the Converter Context of the corresponding type for the task size.
+
+/// Number of Domain Size Cache entries per collapse level (12 used, padded to a cache line multiple)
+const unsigned int DomainStride = 16;
+
+/// The highest collapse level whose node numbers are taken in machine words: below level
+/// L + 1 the distance from a multinode root stays under 2^(3L + 4), which fits up to L = 19.
+const unsigned int MaxNativeDomainLevel = 19;
+
+/// Largest digit width of the radix strings (the digit table takes 2^k entries)
+const unsigned int MaxRadixBits = 16;
+/// Default digit width of the radix strings: 256-entry table, a third of the octal levels
+const unsigned int DefaultRadixBits = 8;
+
+/// Domain Levels: the base subtree offsets of the unreduced collapse levels.
+///
+/// Only the top level of a tree depends on the task size; the levels below are
+/// the same for every n. They are built with exact shifts in the node number type,
+/// once per process, and grow lazily as contexts for larger task sizes appear.
+template<typename NodeNumber> class DomainLevels
+{
+public:
+	static const NodeNumber* GetLevel(unsigned int level);
+};
+
+/// Converter Context: the Domain Size Cache for a single task size.
+///
+/// The context takes the levels below the top from DomainLevels and builds the
+/// reduced top level for itself, in cache-line-aligned memory. Afterwards it is
+/// only read, so any number of threads may share one. Contexts for different
+/// task sizes and node number types coexist in one process, from n = 3 up to
+/// any size NTL::ZZ takes. The context also holds the generated digit table of
+/// the radix strings (see below) for the digit width given.
+template<typename NodeNumber> class ConverterContext
+{
+public:
+	explicit ConverterContext(unsigned int TaskSize, unsigned int RadixBits = DefaultRadixBits);
+	~ConverterContext();
+
+	ConverterContext(const ConverterContext&) = delete;
+	ConverterContext& operator=(const ConverterContext&) = delete;
+
+	/// Task Size the context was built for
+	unsigned int GetTaskSize() const { return TaskSize; }
+
+	/// Base subtree offsets (DomainStride entries) of a collapse level up to GetMaxDomainDepth()
+	const NodeNumber* GetDomainLevel(unsigned int level) const { return Levels[level]; }
+
+	/// Base subtree offsets of a level below the top, up to MaxNativeDomainLevel, in machine words
+	const uint64_t* GetNativeLevel(unsigned int level) const { return NativeLevels[level]; }
+
+	/// Digit width k of the radix strings
+	unsigned int GetRadixBits() const { return RadixBits; }
+
+	/// Number of digits in a radix string: ceil(n / k)
+	unsigned int GetRadixStringSize() const { return (TaskSize + RadixBits - 1) / RadixBits; }
+
+	/// Radix digit table entry for the k top bits h of the remaining offset: the digit, and its item count above bit 16
+	uint32_t GetRadixEntry(unsigned int h) const { return RadixTable[h]; }
+
+	/// Rank table entry for the digit d: the k offset bits of the group, and its item count above bit 16
+	uint32_t GetRankEntry(unsigned int d) const { return RankTable[d]; }
+
+private:
+	unsigned int TaskSize;				///< Task Size the table is built for;
+	unsigned int RadixBits;				///< Digit width of the radix strings;
+	std::vector<uint32_t> RadixTable;		///< Radix digit table, 2^RadixBits entries;
+	std::vector<uint32_t> RankTable;		///< Its inverse, digit to offset bits;
+	std::vector<const NodeNumber*> Levels;		///< All the collapse levels, the lowest first;
+	std::vector<const uint64_t*> NativeLevels;	///< The lowest levels in machine words;
+	NodeNumber* Top;				///< The top level (owned);
+};
+
 void GetLiteralStringByMask(unsigned int TaskSize, DomainType* lit, NTL::vec_GF2 mask);
-void GetLiteralStringByNumber(unsigned int TaskSize, DomainType* e, NTL::ZZ number);
-NTL::ZZ GetDomainStartFromLiteralString(DomainType* LiteralString, unsigned int offset, unsigned int ReductionRate);
+template<typename NodeNumber> void GetLiteralStringByNumber(const ConverterContext<NodeNumber>& ctx, DomainType* e, NodeNumber number);
+template<typename NodeNumber = NTL::ZZ> NodeNumber GetDomainStartFromLiteralString(DomainType* LiteralString, unsigned int offset, unsigned int ReductionRate);
 void SetMaskByLiteralString(unsigned int TaskSize, NTL::vec_GF2* mask, DomainType* LiteralString);
-NTL::ZZ GetNumberByLiteralString(unsigned int TaskSize, DomainType* lit);
+template<typename NodeNumber> NodeNumber GetNumberByLiteralString(const ConverterContext<NodeNumber>& ctx, DomainType* lit);
+
+// Radix Strings
+//
+// A radix string splits the items into groups of k (the context radix bits)
+// aligned to the end of the vector, like the literal string does with k = 3:
+// digit g holds the padded items k*g .. k*g+k-1 at bits 0 .. k-1, with
+// pad = k*ceil(n/k) - n virtual items in front of item 0. Digit 0 is the top
+// group. For k = 3 the digits are those of the literal string, top first.
+//
+// Unranking walks the items from the top, keeping the offset c of the node
+// among the branches of the items left. An item is taken when the top bit of
+// c is clear (c then drops by one, for the item node itself), and skipped
+// otherwise (the bit is cleared). While c stays above k below the group, the
+// borrows never reach the group bits, so a whole group is decided by its k
+// top bits of c alone: one lookup in a generated table of 2^k entries gives
+// the digit and the count to take off c. For k = 8 the table takes 1 KB.
+//
+// The offset c is kept in the caller's packed mask buffer: the bits of the
+// items decided are clear in it, so the items taken are set in their place,
+// and nothing is allocated. Ranking adds the offset bits and item count of
+// each group back by a lookup in the inverse table. The tree engines enter
+// their fragments through GetPackedMaskByRadix().
+
+void SetPackedMaskByRadixString(unsigned int TaskSize, unsigned int RadixBits, uint64_t* packed, const uint16_t* digits);
+void GetRadixStringByPackedMask(unsigned int TaskSize, unsigned int RadixBits, uint16_t* digits, const uint64_t* packed);
+template<typename NodeNumber> void GetRadixStringByNumber(const ConverterContext<NodeNumber>& ctx, uint16_t* digits, uint64_t* packed, const NodeNumber& number);
+template<typename NodeNumber> void GetPackedMaskByRadix(const ConverterContext<NodeNumber>& ctx, uint64_t* packed, const NodeNumber& number);
+template<typename NodeNumber> NodeNumber GetNumberByRadixString(const ConverterContext<NodeNumber>& ctx, const uint16_t* digits);
+
+// Packed Masks
+//
+// A packed mask holds the packing vector in machine words, least significant
+// word first, item i at bit (TaskSize-1-i) of the whole multi-word number M.
+// In this order the node number has a closed form: an empty mask is node 0,
+// and a mask of k items is node k + 2^n - M - lowbit(M), where lowbit(M) is
+// also the node count of the subtree rooted at the packing. The functions
+// below rank and unrank in O(n/64) word operations and need no Converter
+// Context; they agree with the literal string functions above bit for bit.
+
+/// Number of 64-bit words in a packed mask for the given task size
+inline unsigned int GetPackedMaskSize(unsigned int TaskSize) { return (TaskSize + 63) / 64; }
+
+/// Checks whether the item is included into the packed mask
+inline bool GetPackedItem(unsigned int TaskSize, const uint64_t* packed, unsigned int item)
+{
+	unsigned int b = TaskSize - 1 - item;
+	return (packed[b >> 6] >> (b & 63)) & 1;
+}
+
+/// Includes the item into the packed mask or excludes it
+inline void FlipPackedItem(unsigned int TaskSize, uint64_t* packed, unsigned int item)
+{
+	unsigned int b = TaskSize - 1 - item;
+	packed[b >> 6] ^= 1ULL << (b & 63);
+}
+
+/// Gets the last item included into the packed mask (its lowest set bit); -1 for the empty mask
+inline int GetLastPackedItem(unsigned int TaskSize, const uint64_t* packed)
+{
+	unsigned int words = GetPackedMaskSize(TaskSize);
+	for (unsigned int i = 0; i < words; i++)
+		if (packed[i]) return (int)TaskSize - 1 - (int)(64 * i + __builtin_ctzll(packed[i]));
+	return -1;
+}
+
+/// Gets the node count of the subtree rooted at the packing: lowbit(M), or 2^n for the root
+template<typename NodeNumber> inline NodeNumber GetPackedSubtreeSize(unsigned int TaskSize, const uint64_t* packed)
+{
+	return PowerOfTwo<NodeNumber>(TaskSize - 1 - GetLastPackedItem(TaskSize, packed));
+}
+
+/// Gets the ordinal number of the first node past the subtree of the given one (2^n past the last node)
+template<typename NodeNumber> inline NodeNumber GetNextSiblingByPackedMask(unsigned int TaskSize, const uint64_t* packed, const NodeNumber& number)
+{
+	return number + GetPackedSubtreeSize<NodeNumber>(TaskSize, packed);
+}
+
+void PackMask(unsigned int TaskSize, uint64_t* packed, const NTL::vec_GF2& mask);
+void UnpackMask(unsigned int TaskSize, NTL::vec_GF2* mask, const uint64_t* packed);
+template<typename NodeNumber> NodeNumber GetNumberByPackedMask(unsigned int TaskSize, const uint64_t* packed);
+template<typename NodeNumber> void GetPackedMaskByNumber(unsigned int TaskSize, uint64_t* packed, const NodeNumber& number);
+template<typename NodeNumber> NodeNumber GetSubtreeSizeByNumber(unsigned int TaskSize, const NodeNumber& number);
+template<typename NodeNumber> NodeNumber GetNextSiblingByNumber(unsigned int TaskSize, const NodeNumber& number);
+template<typename NodeNumber> void SplitNodeRange(const ConverterContext<NodeNumber>& ctx, const NodeNumber& first, const NodeNumber& last,
+                                                  std::vector<uint64_t>* roots, std::vector<unsigned int>* depths);
+
+// Batch Unranking
+//
+// Consecutive node numbers differ by a single preorder step, so a run of
+// packings is unranked once and then stepped: the step touches one or two
+// items, and their weights follow with one or two additions.
+
+/// Turns the packed mask into the one of the next node in preorder (the mask must not be the last node)
+/// @return The item added by the step; the item dropped by a step aside is returned in *dropped (-1 if none);
+inline int NextPackedMask(unsigned int TaskSize, uint64_t* packed, int* dropped)
+{
+	int last = GetLastPackedItem(TaskSize, packed);
+	*dropped = -1;
+	if (last == (int)TaskSize - 1)
+	{
+		// Go back: drop the last item of the tree, then step aside from the new last one
+		FlipPackedItem(TaskSize, packed, last);
+		last = GetLastPackedItem(TaskSize, packed);
+		FlipPackedItem(TaskSize, packed, last);
+		*dropped = (int)TaskSize - 1;
+		FlipPackedItem(TaskSize, packed, last + 1);
+		return last + 1;
+	}
+	FlipPackedItem(TaskSize, packed, last + 1);
+	return last + 1;
+}
+
+/// Turns the packed mask into the one of the first node past its branch (the branch must not end the tree)
+/// @return The item added by the step; the items from the one before it to the end of the tree are dropped;
+inline int SkipPackedBranch(unsigned int TaskSize, uint64_t* packed)
+{
+	int dropped;
+	int last = GetLastPackedItem(TaskSize, packed);
+	if (last == (int)TaskSize - 1) return NextPackedMask(TaskSize, packed, &dropped);
+	FlipPackedItem(TaskSize, packed, last);
+	FlipPackedItem(TaskSize, packed, last + 1);
+	return last + 1;
+}
+
+/// Unranks count consecutive nodes starting with the given one.
+///
+/// The first node is unranked through the radix digit table of the context.
+///
+/// @param	ctx		Converter context for the task size;
+/// @param[out]	packed		Memory buffer of count * GetPackedMaskSize() words, one mask after another;
+/// @param	start		Ordinal number of the first node;
+/// @param	count		Number of nodes to unrank (the last one must not exceed 2^n - 1);
+/// @param	items		Knapsack vector to weigh the packings by, or 0;
+/// @param[out]	weights		Memory buffer of count weights, or 0;
+template<typename NodeNumber, typename Weight>
+void GetPackedMasksByNumber(const ConverterContext<NodeNumber>& ctx, uint64_t* packed, const NodeNumber& start, unsigned int count,
+                            const Weight* items = 0, Weight* weights = 0)
+{
+	unsigned int TaskSize = ctx.GetTaskSize();
+	unsigned int words = GetPackedMaskSize(TaskSize);
+	if (count == 0) return;
+
+	GetPackedMaskByRadix(ctx, packed, start);
+	if (weights)
+	{
+		weights[0] = 0;
+		for (unsigned int i = 0; i < TaskSize; i++)
+			if (GetPackedItem(TaskSize, packed, i)) AddWeight(weights[0], items[i]);
+	}
+
+	for (unsigned int j = 1; j < count; j++)
+	{
+		uint64_t* mask = packed + j * words;
+		memcpy(mask, mask - words, words * sizeof(uint64_t));
+
+		int dropped;
+		int added = NextPackedMask(TaskSize, mask, &dropped);
+		if (weights)
+		{
+			weights[j] = weights[j - 1];
+			if (dropped >= 0)
+			{
+				SubWeight(weights[j], items[dropped]);
+				SubWeight(weights[j], items[added - 1]);
+			}
+			AddWeight(weights[j], items[added]);
+		}
+	}
+	return;
+}
+
+// Literal String Stepping
+//
+// The literal string changes in its low levels only from one node to the
+// next: a step flips one or three items around the last one, and the last
+// item is found by scanning the digits from the last group up. In preorder
+// half of the nodes end with item n-1, a quarter with item n-2 and so on, so
+// the scan, and thus a step, takes amortized O(1) over a streamed node range.
+// These functions need no Converter Context and work for any task size.
+
+/// Gets the last item included into the packing given by its literal string; -1 for the root
+inline int GetLastLiteralItem(unsigned int TaskSize, const DomainType* lit)
+{
+	unsigned int pad = GetTopDomainReductionRate(TaskSize);
+	unsigned int groups = (TaskSize + pad) / 3;
+	for (unsigned int j = 1; j <= groups; j++)
+		if (lit[j] != Domain_Lv0) return (int)(3 * (groups - j)) + 31 - __builtin_clz((unsigned int)lit[j]) - (int)pad;
+	return -1;
+}
+
+/// Includes the item into the packing given by its literal string or excludes it
+inline void FlipLiteralItem(unsigned int TaskSize, DomainType* lit, unsigned int item)
+{
+	unsigned int pad = GetTopDomainReductionRate(TaskSize);
+	unsigned int p = item + pad;
+	unsigned int j = (TaskSize + pad) / 3 - p / 3;
+	lit[j] = (DomainType)((unsigned int)lit[j] ^ (1u << (p % 3)));
+}
+
+/// Turns the literal string into the one of the next node in preorder (the node must not be the last one)
+/// @return The item added by the step; the items from the one before it to the end of the tree are dropped;
+inline int NextLiteral(unsigned int TaskSize, DomainType* lit)
+{
+	int last = GetLastLiteralItem(TaskSize, lit);
+	if (last == (int)TaskSize - 1)
+	{
+		// Go back: drop the last item of the tree, then step aside from the new last one
+		FlipLiteralItem(TaskSize, lit, last);
+		last = GetLastLiteralItem(TaskSize, lit);
+		FlipLiteralItem(TaskSize, lit, last);
+	}
+	FlipLiteralItem(TaskSize, lit, last + 1);
+	return last + 1;
+}
+
+/// Turns the literal string into the one of the first node past its branch (the branch must not end the tree)
+/// @return The item added by the step; the items from the one before it to the end of the tree are dropped;
+inline int SkipLiteralBranch(unsigned int TaskSize, DomainType* lit)
+{
+	int last = GetLastLiteralItem(TaskSize, lit);
+	if (last == (int)TaskSize - 1) return NextLiteral(TaskSize, lit);
+	FlipLiteralItem(TaskSize, lit, last);
+	FlipLiteralItem(TaskSize, lit, last + 1);
+	return last + 1;
+}
+
+/// Moves the literal string k nodes ahead in preorder (the node reached must exist).
+///
+/// Whole branches that fit into the remaining distance are skipped, otherwise
+/// the walk descends into the first child, so that no more than 2n steps are
+/// taken for any k and only the levels below the common ancestor are touched.
+///
+/// @param	TaskSize	Task Size for the corresponding Knapsack Problem;
+/// @param	lit		The literal string to advance;
+/// @param	k		Number of nodes to move ahead;
+template<typename NodeNumber>
+void AdvanceLiteral(unsigned int TaskSize, DomainType* lit, NodeNumber k)
+{
+	NodeNumber branch;
+	while (k > 0)
+	{
+		int last = GetLastLiteralItem(TaskSize, lit);
+		branch = PowerOfTwo<NodeNumber>(TaskSize - 1 - last);
+		if (k < branch) { NextLiteral(TaskSize, lit); k -= 1; }
+		else { SkipLiteralBranch(TaskSize, lit); k -= branch; }
+	}
+	return;
+}
+
+// Packed Literal Strings
+//
+// A packed literal string keeps the digits of the literal string 3 bits each,
+// 21 to a 64-bit word (bit 63 stays clear), the last group first: the digit of
+// level l, lit[l + 1] above, sits at bits 3*(l%21) of word l/21. Its length
+// is GetPackedLiteralLength() digits, so no sentinels are scanned for. Digit
+// l is field l of the packed mask with bits 0 and 2 swapped (item bit b of
+// the digit is mask bit 3l + 2 - b), so the conversions to and from packed
+// masks take a few shifts and masks per word, and for n <= 63 the literal
+// string is one word.
+
+/// Number of digits per packed literal string word
+const unsigned int PackedLiteralDigits = 21;
+
+/// Number of digits (item groups) in the literal string of the given task size
+inline unsigned int GetPackedLiteralLength(unsigned int TaskSize) { return (TaskSize + GetTopDomainReductionRate(TaskSize)) / 3; }
+
+/// Number of 64-bit words in a packed literal string for the given task size
+inline unsigned int GetPackedLiteralSize(unsigned int TaskSize) { return (GetPackedLiteralLength(TaskSize) + PackedLiteralDigits - 1) / PackedLiteralDigits; }
+
+/// Gets the digit of the given level (0 for the last group)
+inline unsigned int GetPackedLiteralDigit(const uint64_t* plit, unsigned int level)
+{
+	return (unsigned int)(plit[level / PackedLiteralDigits] >> (3 * (level % PackedLiteralDigits))) & 7;
+}
+
+/// Sets the digit of the packed literal string at the given level
+inline void SetPackedLiteralDigit(uint64_t* plit, unsigned int level, unsigned int digit)
+{
+	unsigned int shift = 3 * (level % PackedLiteralDigits);
+	uint64_t& word = plit[level / PackedLiteralDigits];
+	word = (word & ~(7ULL << shift)) | (uint64_t)digit << shift;
+}
 
-void InitializeDomainSizeCache(unsigned int ts);
-void DeinitializeDomainSizeCache();
+/// Swaps bits 0 and 2 of every digit of a word: literal digits to packed mask fields and back
+inline uint64_t ReverseLiteralDigits(uint64_t x)
+{
+	const uint64_t low = 0x1249249249249249ULL;
+	return (x & (low << 1)) | ((x & low) << 2) | ((x >> 2) & low);
+}
+
+void PackLiteralString(unsigned int TaskSize, uint64_t* plit, const DomainType* lit);
+void UnpackLiteralString(unsigned int TaskSize, DomainType* lit, const uint64_t* plit);
+void SetPackedMaskByPackedLiteral(unsigned int TaskSize, uint64_t* packed, const uint64_t* plit);
+void GetPackedLiteralByPackedMask(unsigned int TaskSize, uint64_t* plit, const uint64_t* packed);
+void SetMaskByPackedLiteral(unsigned int TaskSize, NTL::vec_GF2* mask, const uint64_t* plit);
+void GetPackedLiteralByMask(unsigned int TaskSize, uint64_t* plit, const NTL::vec_GF2& mask);
+template<typename NodeNumber> void GetPackedLiteralByNumber(const ConverterContext<NodeNumber>& ctx, uint64_t* plit, NodeNumber number);
+template<typename NodeNumber> NodeNumber GetNumberByPackedLiteral(const ConverterContext<NodeNumber>& ctx, const uint64_t* plit);
+
+/// Gets the last item included into the packing given by its packed literal string; -1 for the root
+inline int GetLastPackedLiteralItem(unsigned int TaskSize, const uint64_t* plit)
+{
+	unsigned int words = GetPackedLiteralSize(TaskSize);
+	for (unsigned int w = 0; w < words; w++)
+		if (plit[w])
+		{
+			// The last item of the lowest digit is its highest bit
+			unsigned int l = __builtin_ctzll(plit[w]) / 3;
+			unsigned int b = 31 - __builtin_clz((unsigned int)(plit[w] >> (3 * l)) & 7);
+			return (int)TaskSize - 1 - (int)(3 * (PackedLiteralDigits * w + l) + 2 - b);
+		}
+	return -1;
+}
+
+/// Includes the item into the packing given by its packed literal string or excludes it
+inline void FlipPackedLiteralItem(unsigned int TaskSize, uint64_t* plit, unsigned int item)
+{
+	unsigned int m = TaskSize - 1 - item;
+	unsigned int l = m / 3;
+	plit[l / PackedLiteralDigits] ^= 1ULL << (3 * (l % PackedLiteralDigits) + 2 - m % 3);
+}
+
+/// Turns the packed literal string into the one of the next node in preorder (the node must not be the last one)
+/// @return The item added by the step; the items from the one before it to the end of the tree are dropped;
+inline int NextPackedLiteral(unsigned int TaskSize, uint64_t* plit)
+{
+	int last = GetLastPackedLiteralItem(TaskSize, plit);
+	if (last == (int)TaskSize - 1)
+	{
+		// Go back: drop the last item of the tree, then step aside from the new last one
+		FlipPackedLiteralItem(TaskSize, plit, last);
+		last = GetLastPackedLiteralItem(TaskSize, plit);
+		FlipPackedLiteralItem(TaskSize, plit, last);
+	}
+	FlipPackedLiteralItem(TaskSize, plit, last + 1);
+	return last + 1;
+}
+
+/// Turns the packed literal string into the one of the first node past its branch (the branch must not end the tree)
+/// @return The item added by the step; the items from the one before it to the end of the tree are dropped;
+inline int SkipPackedLiteralBranch(unsigned int TaskSize, uint64_t* plit)
+{
+	int last = GetLastPackedLiteralItem(TaskSize, plit);
+	if (last == (int)TaskSize - 1) return NextPackedLiteral(TaskSize, plit);
+	FlipPackedLiteralItem(TaskSize, plit, last);
+	FlipPackedLiteralItem(TaskSize, plit, last + 1);
+	return last + 1;
+}
+
+/// Moves the packed literal string k nodes ahead in preorder (the node reached must exist), as AdvanceLiteral() does
+template<typename NodeNumber>
+void AdvancePackedLiteral(unsigned int TaskSize, uint64_t* plit, NodeNumber k)
+{
+	NodeNumber branch;
+	while (k > 0)
+	{
+		int last = GetLastPackedLiteralItem(TaskSize, plit);
+		branch = PowerOfTwo<NodeNumber>(TaskSize - 1 - last);
+		if (k < branch) { NextPackedLiteral(TaskSize, plit); k -= 1; }
+		else { SkipPackedLiteralBranch(TaskSize, plit); k -= branch; }
+	}
+	return;
+}
 
 #endif
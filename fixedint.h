@@ -0,0 +1,243 @@
+#ifndef _FIXEDINT
+#define _FIXEDINT
+
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <NTL/ZZ.h>
+
+// Fixed-Limb Weights
+//
+// Packing weights never exceed the sum of all the Knapsack items, which is
+// below 2 to the power of the element size. So whenever the element size is
+// known in advance, the weights fit into a fixed number of 64-bit limbs and
+// the search loop may avoid NTL::ZZ (and GMP reallocations) entirely.
+// Limbs are stored least significant first; the values are never negative.
+
+/// Unsigned integer made of a fixed number of 64-bit limbs
+template<int Limbs>
+struct FixedInt
+{
+	unsigned long long limb[Limbs];	///< Limbs, least significant first;
+
+	FixedInt& operator=(unsigned long long a)
+	{
+		limb[0] = a;
+		for (int i = 1; i < Limbs; i++) limb[i] = 0;
+		return *this;
+	}
+};
+
+/// x += a (the carry out of the top limb is lost)
+template<int Limbs>
+inline void AddWeight(FixedInt<Limbs>& x, const FixedInt<Limbs>& a)
+{
+	unsigned char carry = 0;
+	for (int i = 0; i < Limbs; i++)
+		carry = _addcarry_u64(carry, x.limb[i], a.limb[i], &x.limb[i]);
+}
+
+/// x -= a (a must not exceed x)
+template<int Limbs>
+inline void SubWeight(FixedInt<Limbs>& x, const FixedInt<Limbs>& a)
+{
+	unsigned char borrow = 0;
+	for (int i = 0; i < Limbs; i++)
+		borrow = _subborrow_u64(borrow, x.limb[i], a.limb[i], &x.limb[i]);
+}
+
+/// a < b, taken from the borrow out of a - b
+template<int Limbs>
+inline bool operator<(const FixedInt<Limbs>& a, const FixedInt<Limbs>& b)
+{
+	unsigned long long dummy;
+	unsigned char borrow = 0;
+	for (int i = 0; i < Limbs; i++)
+		borrow = _subborrow_u64(borrow, a.limb[i], b.limb[i], &dummy);
+	return borrow;
+}
+
+template<int Limbs>
+inline bool operator>(const FixedInt<Limbs>& a, const FixedInt<Limbs>& b) { return b < a; }
+
+template<int Limbs>
+inline bool operator==(const FixedInt<Limbs>& a, const FixedInt<Limbs>& b)
+{
+	unsigned long long diff = 0;
+	for (int i = 0; i < Limbs; i++) diff |= a.limb[i] ^ b.limb[i];
+	return !diff;
+}
+
+template<int Limbs>
+inline bool operator!=(const FixedInt<Limbs>& a, const FixedInt<Limbs>& b) { return !(a == b); }
+
+// Single-limb weights are plain machine words
+inline void AddWeight(FixedInt<1>& x, const FixedInt<1>& a) { x.limb[0] += a.limb[0]; }
+inline void SubWeight(FixedInt<1>& x, const FixedInt<1>& a) { x.limb[0] -= a.limb[0]; }
+inline bool operator<(const FixedInt<1>& a, const FixedInt<1>& b) { return a.limb[0] < b.limb[0]; }
+inline bool operator==(const FixedInt<1>& a, const FixedInt<1>& b) { return a.limb[0] == b.limb[0]; }
+
+// NTL::ZZ fallback for the element sizes beyond the widest fixed type
+inline void AddWeight(NTL::ZZ& x, const NTL::ZZ& a) { NTL::add(x, x, a); }
+inline void SubWeight(NTL::ZZ& x, const NTL::ZZ& a) { NTL::sub(x, x, a); }
+
+/// Converts a non-negative NTL::ZZ to a weight (truncating to the type width)
+template<typename Weight> inline Weight WeightFromZZ(const NTL::ZZ& a)
+{
+	Weight r;
+	NTL::BytesFromZZ((unsigned char*)r.limb, a, sizeof(r.limb));
+	return r;
+}
+template<> inline NTL::ZZ WeightFromZZ<NTL::ZZ>(const NTL::ZZ& a) { return a; }
+
+/// Converts a weight to NTL::ZZ
+template<int Limbs> inline NTL::ZZ WeightToZZ(const FixedInt<Limbs>& a) { return NTL::ZZFromBytes((const unsigned char*)a.limb, sizeof(a.limb)); }
+inline NTL::ZZ WeightToZZ(const NTL::ZZ& a) { return a; }
+
+// Table Lookup
+//
+// The leaf blocks of the tree search resolve a whole bottom branch by looking
+// the remaining weight up in a small table of tail subset sums. Single-limb
+// tables are scanned with one vector compare per 8 (AVX-512) or 4 (AVX2) entries.
+// The octal engine compares all the 8 digit sums of an item group at once.
+
+/// Count the table entries equal to the given weight
+template<typename Weight>
+inline int CountWeightMatches(const Weight* table, int size, const Weight& a)
+{
+	int r = 0;
+	for (int i = 0; i < size; i++) r += table[i] == a;
+	return r;
+}
+
+inline int CountWeightMatches(const FixedInt<1>* table, int size, const FixedInt<1>& a)
+{
+	const long long* p = (const long long*)table;
+	int r = 0, i = 0;
+#if defined(__AVX512F__)
+	__m512i key = _mm512_set1_epi64((long long)a.limb[0]);
+	for (; i + 8 <= size; i += 8)
+		r += __builtin_popcount(_mm512_cmpeq_epi64_mask(_mm512_loadu_si512(p + i), key));
+#elif defined(__AVX2__)
+	__m256i key = _mm256_set1_epi64x((long long)a.limb[0]);
+	for (; i + 4 <= size; i += 4)
+		r += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(
+			_mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)(p + i)), key))));
+#endif
+	for (; i < size; i++) r += p[i] == (long long)a.limb[0];
+	return r;
+}
+
+/// Compare the 8 entries of a digit table with the key: bit d is set for table[d] < key
+template<typename Weight>
+inline unsigned DigitsBelow(const Weight* table, const Weight& key)
+{
+	unsigned r = 0;
+	for (int d = 0; d < 8; d++) r |= (unsigned)(table[d] < key) << d;
+	return r;
+}
+
+/// Compare the 8 entries of a digit table with the key: bit d is set for table[d] == key
+template<typename Weight>
+inline unsigned DigitsEqual(const Weight* table, const Weight& key)
+{
+	unsigned r = 0;
+	for (int d = 0; d < 8; d++) r |= (unsigned)(table[d] == key) << d;
+	return r;
+}
+
+#if defined(__AVX512F__)
+inline unsigned DigitsBelow(const FixedInt<1>* table, const FixedInt<1>& key)
+{
+	return _mm512_cmplt_epu64_mask(_mm512_loadu_si512(table), _mm512_set1_epi64((long long)key.limb[0]));
+}
+
+inline unsigned DigitsEqual(const FixedInt<1>* table, const FixedInt<1>& key)
+{
+	return _mm512_cmpeq_epu64_mask(_mm512_loadu_si512(table), _mm512_set1_epi64((long long)key.limb[0]));
+}
+#elif defined(__AVX2__)
+inline unsigned DigitsBelow(const FixedInt<1>* table, const FixedInt<1>& key)
+{
+	// No unsigned 64-bit compare in AVX2: flip the sign bits and compare signed
+	const __m256i sign = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+	__m256i k = _mm256_xor_si256(_mm256_set1_epi64x((long long)key.limb[0]), sign);
+	__m256i lo = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)table), sign);
+	__m256i hi = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)table + 1), sign);
+	return (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, lo)))
+		| (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, hi))) << 4;
+}
+
+inline unsigned DigitsEqual(const FixedInt<1>* table, const FixedInt<1>& key)
+{
+	__m256i k = _mm256_set1_epi64x((long long)key.limb[0]);
+	__m256i lo = _mm256_loadu_si256((const __m256i*)table);
+	__m256i hi = _mm256_loadu_si256((const __m256i*)table + 1);
+	return (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(k, lo)))
+		| (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(k, hi))) << 4;
+}
+#endif
+
+// Sorting
+//
+// The subset sum lists of the meet in the middle engines run into millions of
+// entries. Fixed-limb weights are sorted by LSD radix sort on 11-bit digits:
+// the 2048-entry histogram stays in L1 cache, the passes stream through the
+// memory, and the digits above the largest weight are never visited.
+
+/// Number of bits in a radix sort digit
+const int SortDigitBits = 11;
+
+/// Extract the radix sort digit starting at the given bit
+template<int Limbs> inline unsigned SortDigit(const FixedInt<Limbs>& a, int shift)
+{
+	int k = shift >> 6, bit = shift & 63;
+	unsigned long long v = a.limb[k] >> bit;
+	if (bit > 64 - SortDigitBits && k + 1 < Limbs) v |= a.limb[k + 1] << (64 - bit);
+	return (unsigned)(v & ((1u << SortDigitBits) - 1));
+}
+
+/// Sort the weights ascending (buf is a scratch buffer of any size)
+template<int Limbs>
+void SortWeights(std::vector< FixedInt<Limbs> >& v, std::vector< FixedInt<Limbs> >& buf)
+{
+	if (v.size() < 2) return;
+	buf.resize(v.size());
+
+	/* Bit length of the largest weight bounds the digits to sort by */
+	FixedInt<Limbs> any; any = 0;
+	for (size_t i = 0; i < v.size(); i++)
+		for (int k = 0; k < Limbs; k++) any.limb[k] |= v[i].limb[k];
+	int bits = 0;
+	for (int k = Limbs - 1; k >= 0; k--)
+		if (any.limb[k]) { bits = k * 64 + 64 - __builtin_clzll(any.limb[k]); break; }
+
+	std::vector<size_t> count(size_t(1) << SortDigitBits);
+	for (int shift = 0; shift < bits; shift += SortDigitBits)
+	{
+		std::fill(count.begin(), count.end(), 0);
+		for (size_t i = 0; i < v.size(); i++) count[SortDigit(v[i], shift)]++;
+
+		/* A digit shared by all the weights does not change the order */
+		if (count[SortDigit(v[0], shift)] == v.size()) continue;
+
+		size_t pos = 0;
+		for (size_t d = 0; d < count.size(); d++) { size_t c = count[d]; count[d] = pos; pos += c; }
+		for (size_t i = 0; i < v.size(); i++) buf[count[SortDigit(v[i], shift)]++] = v[i];
+		v.swap(buf);
+	}
+}
+
+/// Sort the weights ascending (NTL::ZZ fallback)
+inline void SortWeights(std::vector<NTL::ZZ>& v, std::vector<NTL::ZZ>&)
+{
+	std::sort(v.begin(), v.end());
+}
+
+/// The largest element size (in bits) that fits into the given weight type
+template<typename Weight> struct WeightLimit { static const int MaxElementSize = sizeof(Weight) * 8; };
+template<> struct WeightLimit<NTL::ZZ> { static const int MaxElementSize = 1 << 30; };
+
+#endif
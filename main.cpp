@@ -3,14 +3,68 @@
 
 #include <stdio.h>
 #include <cstring>
+#include <errno.h>
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <NTL/RR.h>
 
 #include "converter.h"
+#include "fixedint.h"
+
+/// Implementations of the tree search
+enum EngineType
+{
+    Engine_MACRO,   ///< GoForward/GoSide/GoBack over the packed mask;
+    Engine_STACK,   ///< Packed machine word mask with a stack of partial sums;
+    Engine_MITM,    ///< Meet in the middle: sorted subset sums of two halves;
+    Engine_SS,      ///< Schroeppel-Shamir: sums of four quarters streamed by two heaps;
+    Engine_OCTAL,   ///< One octal digit (3-item group) of the literal string per step;
+    Engine_GRAY,    ///< Exhaustive: every packing in reflected Gray code order, one item flip per step;
+    Engine_COUNT
+};
+
+/// Engine names for the command line and the parameter printout
+const char* EngineNames[Engine_COUNT] = {"macro", "stack", "mitm", "ss", "octal", "gray"};
+
+/// Largest task size the meet in the middle engine takes (two lists of 2^(n/2) weights)
+const int MaxMITMTaskSize = 60;
+/// Largest task size the Schroeppel-Shamir engine takes (four lists of 2^(n/4) weights)
+const int MaxSSTaskSize = 120;
+
+/// Smallest leaf block (smaller ones save less than the table lookup costs)
+const int MinLeafBlock = 3;
+/// Largest leaf block (the tail sum table takes 2^k weights)
+const int MaxLeafBlock = 8;
+
+/// Task sizes the macro engine is compiled for one by one, so that the packing
+/// loops unroll and the packed mask stays in registers (64-bit node numbers only)
+const int MinFixedTaskSize = 8;
+const int MaxFixedTaskSize = 63;
+
+/// Number of nodes unranked at once by the non-optimized macro engine
+const unsigned int UnrankBatchSize = 64;
+
+/// Largest subtree (in items below its root) the octal engine resolves
+/// without answering steal requests or cancellation (work stealing and first solution modes)
+const int MaxOctalStealBlock = 28;
+
+/// Number of Gray code steps between the looks at the fragment end and the steal requests
+const unsigned int GrayRun = 1 << 16;
 
 /// The structure holding the parameters of the current experiment
 struct {
@@ -20,48 +74,564 @@ struct {
     int IterCount               = 100;  ///< Number of iterations to run;
     int RelativeTargetWeight    = -1;  ///< Relative target weight of knapsack vector;
     bool OptimizedAlgorithm     = false; ///< Use optimized version of algorithm
+    bool WorkStealing           = false; ///< Let idle workers steal parts of busy fragments
+    EngineType Engine           = Engine_MACRO; ///< Search implementation;
+    int LeafBlock               = 0;    ///< Last items resolved as one block (stack engine; 0 = off);
+    int RadixBits               = DefaultRadixBits; ///< Digit width of the converter radix strings;
+    bool CountAllocs            = false; ///< Count the heap allocations of the search (--count-allocs);
+    int ProbeCount              = 0;    ///< Knuth probes per tree piece to cut fragments of equal cost (0 = equal node counts);
+    const char* SolutionFile    = 0;    ///< File the solutions are recorded to (-f binary, -j JSON lines);
+    bool FirstSolution          = false; ///< Stop all the workers at the first solution (--first);
 } cfg;
 
+/* Allocation counting
+ *
+ * Built with -D KT_COUNT_ALLOCS (glibc only), malloc and its siblings and the
+ * global operator new are interposed, and with --count-allocs every call made
+ * by a worker thread while it searches is counted in a thread-local counter
+ * (GMP and NTL end up in malloc as well). Other builds leave the allocator
+ * alone, so that sanitizers and replacement allocators keep working, and
+ * reject --count-allocs. */
+
+#if defined(KT_COUNT_ALLOCS) && !defined(__GLIBC__)
+#error "KT_COUNT_ALLOCS needs the glibc allocator"
+#endif
+
+/// Set while the calls of the current thread are being counted
+thread_local bool CountingAllocs = false;
+/// Number of allocations counted on the current thread
+thread_local unsigned long ThreadAllocs = 0;
+
+#if defined(KT_COUNT_ALLOCS)
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void* __libc_memalign(size_t alignment, size_t size);
+extern "C" void* __libc_valloc(size_t size);
+extern "C" void* __libc_pvalloc(size_t size);
+
+extern "C" void* malloc(size_t size)
+{
+    if (CountingAllocs) ThreadAllocs++;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    if (CountingAllocs) ThreadAllocs++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+    if (CountingAllocs) ThreadAllocs++;
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+    if (CountingAllocs) ThreadAllocs++;
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1))) return EINVAL;
+    void* p = __libc_memalign(alignment, size);
+    if (!p && size) return ENOMEM;
+    *ptr = p;
+    return 0;
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size)
+{
+    if (CountingAllocs) ThreadAllocs++;
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" void* memalign(size_t alignment, size_t size)
+{
+    if (CountingAllocs) ThreadAllocs++;
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" void* valloc(size_t size)
+{
+    if (CountingAllocs) ThreadAllocs++;
+    return __libc_valloc(size);
+}
+
+extern "C" void* pvalloc(size_t size)
+{
+    if (CountingAllocs) ThreadAllocs++;
+    return __libc_pvalloc(size);
+}
+
+/// Allocates for the global operator new, counted once, with the usual new_handler retries
+static void* CountedNew(size_t size, bool nothrow)
+{
+    if (CountingAllocs) ThreadAllocs++;
+    if (size == 0) size = 1;
+    for (;;)
+    {
+        void* p = __libc_malloc(size);
+        if (p) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+        {
+            if (nothrow) return nullptr;
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void* operator new(size_t size) { return CountedNew(size, false); }
+void* operator new[](size_t size) { return CountedNew(size, false); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return CountedNew(size, true); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return CountedNew(size, true); }
+#endif
+
 /// Experiment Start Time
 time_t rawtime;
 /// Experiment Start Time (local)
 struct tm* timeinfo;
 
-/// Experiment duration
-clock_t clck;
-/// Experiment duration (msec)
-float clck_msec;
+/* Solution Sink
+ *
+ * The solutions the engines count may also be recorded, each one as a packed
+ * mask (see converter.h) or as a node number, both in the original item order
+ * of the instance, as it was before the optimized algorithm sorted the items.
+ * A record takes GetPackedMaskSize(n) little-endian 64-bit words. Every worker
+ * buffers its records and flushes them in batches to a binary file, a JSON
+ * lines file or a callback. The whole-instance engines count pairs of sums
+ * without the subsets behind them, so they record nothing. */
+
+/// Called with a batch of count records, words 64-bit words each, flushed by a worker
+typedef std::function<void(int worker, const uint64_t* records, size_t count, unsigned int words)> SolutionCallback;
+
+/// Number of records a worker buffers before flushing them
+const size_t SolutionBatch = 4096;
+
+/// Largest record (in words) the original item order is restored for by table lookups
+const unsigned int MaxScatterWords = 4;
+
+/// The shared end of the solution sink
+struct {
+    bool             Enabled    = false; ///< The engines hand the solutions over (recording or --first);
+    bool             Record     = false; ///< Buffer the records for the file or the callback;
+    FILE*            File       = 0;     ///< Binary or JSON lines output (0 for none);
+    bool             Json       = false; ///< Write JSON lines instead of binary records;
+    bool             Ranks      = false; ///< Record node numbers instead of packed masks;
+    SolutionCallback Callback;           ///< Receives every flushed batch (may be empty);
+    std::mutex       Lock;               ///< Serializes the flushes;
+    int              Iteration  = 0;     ///< Iteration the records belong to;
+    std::vector<int> Order;              ///< Order[i]: original index of searched item i (empty if unsorted);
+    std::vector<uint64_t> Scatter;       ///< Scatter[(256*p + v)*words]: the mask of byte p equal to v in the original order;
+    bool             Complement = false; ///< The search took sum - w for w: the records take the other items;
+} Sink;
+
+/// Per-worker buffer of the solution sink
+struct SolutionWriter {
+    std::vector<uint64_t> Records;  ///< Buffered records;
+    std::string           Text;     ///< JSON lines of the batch being flushed;
+    size_t                Count;    ///< Number of buffered records;
+    unsigned int          Words;    ///< Words per record;
+    void (*Rank)(unsigned int TaskSize, uint64_t* record); ///< Replaces the mask of a record by its node number (0 for masks);
+};
+
+/// The structure holding the work area and the results of a single worker thread
+struct Worker {
+    int          Rank;              ///< Worker number (former emulated processor number);
+    NTL::ZZ      FragStart;         ///< Number of the first packing to check;
+    NTL::ZZ      FragEnd;           ///< Number of the last packing to check;
+    NTL::ZZ      Solutions;         ///< Counter for solutions found in the fragment;
+    NTL::ZZ      Visited;           ///< Counter for nodes visited by the search loop;
+    NTL::ZZ      OverPruned;        ///< Nodes skipped below packings of weight >= w (solutions included);
+    NTL::ZZ      BoundPruned;       ///< Nodes skipped as even all the remaining items cannot reach w;
+    NTL::ZZ      LeafResolved;      ///< Nodes below the leaf block roots, resolved by the table lookup (-k);
+    NTL::ZZ      GroupSteps;        ///< Digit groups expanded by the octal subtree counts (octal engine);
+    float        Msec;              ///< Fragment processing time (msec);
+    size_t       PeakBytes;         ///< Peak size of the engine's lists and heaps (whole-instance engines);
+    double       EstCost;           ///< Estimated visited nodes of the initial fragment (-t);
+    unsigned long Allocs;           ///< Heap allocations made by the search (--count-allocs);
+    SolutionWriter Out;             ///< Solution sink buffer (-f, -j);
+
+    /* Work stealing */
+    std::mutex              Lock;           ///< Guards the handshake fields below;
+    std::condition_variable Answered;       ///< Signalled when the steal request of this worker is answered;
+    std::atomic<bool>       StealRequest;   ///< Raised by a thief waiting for a part of this fragment;
+    Worker*                 Thief;          ///< The worker waiting for a part of this fragment;
+    bool                    Busy;           ///< The worker is searching a fragment;
+    int                     Answer;         ///< Steal answer: -1 pending, 0 refused, 1 granted;
+    int                     Steals;         ///< Number of fragments stolen by this worker;
+};
+
+/// Smallest number of unvisited nodes a busy worker agrees to split
+const long MinStealSize = 256;
+
+/// Number of workers that hold a non-exhausted fragment (work stealing mode)
+std::atomic<int> BusyWorkers;
+
+/// Guards PoolGeneration; idle thieves wait on PoolChanged instead of polling the victims
+std::mutex PoolLock;
+/// Signalled when a fragment is split or a worker retires
+std::condition_variable PoolChanged;
+/// Bumped on every change that PoolChanged signals
+unsigned long PoolGeneration;
+
+/// Wall clock used to time the workers and the whole iteration
+typedef std::chrono::steady_clock WallClock;
+
+/* First Solution Mode
+ *
+ * With --first the question is only whether a packing of weight w exists.
+ * The worker that finds the first solution raises a shared flag, and the
+ * others look at it once per node (per run of Gray code steps in the gray
+ * engine), so every worker stops within one subtree step. */
+
+/// Raised by the first solution of the iteration (--first)
+std::atomic<bool> SolutionFound;
+/// Start of the current iteration, for the time to the first solution
+WallClock::time_point IterationStart;
+
+/// The first solution of the iteration (--first)
+struct {
+    std::vector<uint64_t> Mask;     ///< Packed mask in the original item order;
+    float                 Msec;     ///< Time from the start of the iteration (msec);
+    int                   Worker;   ///< Worker that found it;
+} First;
+
+/// Checks whether another worker has found the solution to stop at (--first)
+inline bool SearchCancelled()
+{
+    return cfg.FirstSolution && SolutionFound.load(std::memory_order_relaxed);
+}
+
+/// Flush the buffered solution records of the worker to the sink
+void FlushSolutions(Worker* wk);
+
+/// Append the packed mask to the text in hexadecimal, item 0 at the top bit
+void AppendHexMask(std::string& text, const uint64_t* mask, unsigned int words);
+
+/// Record a solution given by its packed mask in the searched item order
+inline void PutSolution(Worker* wk, const uint64_t* packed)
+{
+    SolutionWriter& out = wk->Out;
+    const int n = cfg.TaskSize;
+    uint64_t* rec = &out.Records[out.Count * out.Words];
+    if (Sink.Order.empty()) memcpy(rec, packed, out.Words * sizeof(uint64_t));
+    else if (!Sink.Scatter.empty())
+    {
+        /* Move the items back to their original places a byte of the mask at a time */
+        const unsigned char* bytes = (const unsigned char*)packed;
+        const uint64_t* table = Sink.Scatter.data();
+        memset(rec, 0, out.Words * sizeof(uint64_t));
+        for (int p = 0; p < (n + 7) / 8; p++, table += 256 * out.Words)
+            for (unsigned int i = 0; i < out.Words; i++) rec[i] |= table[bytes[p] * out.Words + i];
+    }
+    else
+    {
+        /* Move every item back to its original place */
+        memset(rec, 0, out.Words * sizeof(uint64_t));
+        for (unsigned int i = 0; i < out.Words; i++)
+            for (uint64_t m = packed[i]; m; m &= m - 1)
+                FlipPackedItem(n, rec, Sink.Order[n - 1 - (64 * i + __builtin_ctzll(m))]);
+    }
+    if (Sink.Complement)
+    {
+        for (unsigned int i = 0; i < out.Words; i++) rec[i] = ~rec[i];
+        if (n % 64) rec[out.Words - 1] &= (1ULL << (n % 64)) - 1;
+    }
+    if (cfg.FirstSolution && !SolutionFound.load(std::memory_order_relaxed) && !SolutionFound.exchange(true))
+    {
+        /* The first solution of all: keep it, the other workers stop on the flag */
+        First.Msec = std::chrono::duration<float, std::milli>(WallClock::now() - IterationStart).count();
+        First.Worker = wk->Rank;
+        memcpy(First.Mask.data(), rec, out.Words * sizeof(uint64_t));
+    }
+    if (!Sink.Record) return;
+    if (out.Rank) out.Rank(n, rec);
+    if (++out.Count == SolutionBatch) FlushSolutions(wk);
+}
 
-/// Current processor number
-int ProcRank = 0;
+/// Replace the packed mask of a record by its node number
+template<typename NodeNumber>
+void RankSolution(unsigned int TaskSize, uint64_t* record)
+{
+    NodeToWords(GetNumberByPackedMask<NodeNumber>(TaskSize, record), record, GetPackedMaskSize(TaskSize));
+}
 
 /// Generate a big random number
 NTL::ZZ BigRandom(int bits);
 
+/// The cost estimates are refined until no tree piece holds over 1/PiecesPerFragment of a fragment
+const int PiecesPerFragment = 16;
+
+/// Split the tree into fragments of equal estimated cost (visited nodes of the optimized search)
+/// @param knp     Knapsack vector sorted descending;
+/// @param w       Target weight;
+/// @param workers Workers receiving the fragment bounds and their estimated costs;
+/// @param rng     Random source of the probes;
+/// @return false if the tree has too few pieces to give every worker one (the fragments are left untouched);
+bool PartitionByEstimate(const NTL::vec_ZZ& knp, const NTL::ZZ& w, std::vector<Worker>& workers, std::mt19937_64& rng);
+
 /// Print help info to the Console
 void PrintHelp();
 /// Print argument error to the Console
 void PrintError(char* arg);
+/// Print a big number right-aligned into a table column of the given width
+void PrintZZ(const NTL::ZZ& value, int width);
+/// Check the node number conversions of converter.h against each other (--self-test, --self-test-all)
+/// @param all Check every node of the task sizes up to SelfTestFullSize instead of samples;
+/// @return 0 if all the checks pass, 1 otherwise;
+int RunSelfTest(bool all);
+
+/// Private copy of the instance in the weight type of the engine (one per worker)
+template<typename Weight>
+struct SearchInstance {
+    std::vector<Weight> Knp;        ///< Knapsack vector;
+    std::vector<Weight> Suffix;     ///< Suffix sums of the Knapsack vector: Suffix[i] = Knp[i] + ... + Knp[n-1];
+    std::vector<Weight> LeafSums;   ///< Subset sums of the leaf block items, bit j for item n-k+j;
+    Weight              W;          ///< Target weight;
+
+    /* Octal engine: the items are padded in front to a multiple of 3 and split
+     * into groups; bit b of the digit of group g stands for padded item 3g+b */
+    int                        GroupCount;     ///< Number of 3-item groups (literal string length);
+    int                        GroupPad;       ///< Missing items of the first group (top domain reduction rate);
+    std::vector<Weight>        DigitSums;      ///< DigitSums[8g+d]: weight of digit d of group g;
+    std::vector<Weight>        GroupSuffix;    ///< GroupSuffix[g]: weight of all the groups from g on;
+    std::vector<unsigned char> DigitValid;     ///< Bit d set if digit d exists in group g (no padding items);
+    std::vector<unsigned char> DigitCountable; ///< Bit d set if a packing ending with digit d counts as a solution;
+};
+
+/// Work areas and node counters of the fragment searches (one per worker).
+/// RunWorker() sizes the work areas before the search and turns the counters into
+/// the Worker results after it, so a search, stolen fragments included, allocates nothing.
+template<typename NodeNumber, typename Weight>
+struct SearchState {
+    NodeNumber Solutions;       ///< Counter for solutions found in the fragments;
+    NodeNumber Visited;         ///< Counter for nodes visited by the search loop;
+    NodeNumber OverPruned;      ///< Nodes skipped below packings of weight >= w (solutions included);
+    NodeNumber BoundPruned;     ///< Nodes skipped as even all the remaining items cannot reach w;
+    NodeNumber LeafResolved;    ///< Nodes below the leaf block roots (stack engine, -k);
+    long       GroupSteps;      ///< Digit groups expanded by the octal subtree counts (octal engine);
+
+    std::vector<uint64_t>     Mask;         ///< Packed mask of the packing (macro, stack, gray), of a solution (octal);
+    std::vector<uint64_t>     Found;        ///< Packed mask of a leaf block solution (stack engine, -k);
+    std::vector<uint64_t>     Batch;        ///< Packed masks of an unrank batch (macro engine without -o);
+    std::vector<Weight>       BatchWeights; ///< Their packing weights;
+    std::vector<Weight>       Sums;         ///< Prefix sums of the packing (stack engine), of the groups (octal engine);
+    std::vector<uint64_t>     Roots;        ///< Packed masks of the pieces of a fragment (stack engine);
+    std::vector<unsigned int> Heights;      ///< Their heights;
+    std::vector<uint64_t>     Literal;      ///< Packed literal string of the current node (octal engine);
+    std::vector<uint64_t>     SubtreeLiteral; ///< Packed literal string the subtree solutions are written to (octal engine);
+    std::vector<Weight>       Base;         ///< Subtree counting work area (octal engine);
+    std::vector<unsigned>     Pending;      ///< Subtree counting work area (octal engine);
+    std::vector<uint64_t>     Index;        ///< Gray code index of the packing, one spare word for the carry (gray engine);
+};
+
+/// Worker thread entry point: search the own fragment, then steal work if enabled
+/// @tparam NodeNumber Node number type wide enough for the task size;
+/// @tparam Weight     Weight type wide enough for the element size;
+/// @param wk   Worker holding the fragment bounds; receives the results;
+/// @param pool All the workers of the iteration (steal victims);
+/// @param knp  Knapsack vector (shared, read-only);
+/// @param w    Target weight (shared, read-only);
+/// @param conv Converter Context for the task size (shared, read-only);
+template<typename NodeNumber, typename Weight>
+void RunWorker(Worker* wk, std::vector<Worker>* pool, const NTL::vec_ZZ& knp, const NTL::ZZ& w,
+               const ConverterContext<NodeNumber>& conv);
+
+/// Worker thread entry point type (RunWorker() instantiated for the number types and bound to a context)
+typedef std::function<void(Worker* wk, std::vector<Worker>* pool, const NTL::vec_ZZ& knp, const NTL::ZZ& w)> WorkerEntry;
+
+/// Pick the worker entry point with the narrowest weight type for the element size
+/// @param ElementSize  Knapsack item size in bits;
+/// @param[out] weight_type Name of the weight type picked;
+/// @param conv Converter Context to bind the entry point to (must outlive the workers);
+template<typename NodeNumber>
+WorkerEntry PickWorkerEntry(int ElementSize, const char** weight_type, const ConverterContext<NodeNumber>& conv);
+
+/// Run the tree search over the fragment of a worker
+/// @tparam NodeNumber Node number type wide enough for the task size;
+/// @tparam Weight     Weight type wide enough for the element size;
+/// @tparam FixedTaskSize Task size compiled in; 0 to take cfg.TaskSize;
+/// @param wk Worker holding the fragment bounds;
+/// @param in Instance (worker's copy);
+/// @param conv Converter Context for the task size;
+/// @param st Work areas of the worker; accumulates the results;
+template<typename NodeNumber, typename Weight, int FixedTaskSize>
+void SearchFragment(Worker* wk, const SearchInstance<Weight>& in, const ConverterContext<NodeNumber>& conv,
+                    SearchState<NodeNumber, Weight>* st);
+
+/// Fragment search entry point of the given node number and weight types
+template<typename NodeNumber, typename Weight> struct FragmentSearch
+{
+    typedef void (*Entry)(Worker*, const SearchInstance<Weight>&, const ConverterContext<NodeNumber>&, SearchState<NodeNumber, Weight>*);
+};
+
+/// Pick the macro engine instance for the task size: one compiled for the very
+/// task size from MinFixedTaskSize to MaxFixedTaskSize (single-limb weights),
+/// the generic one otherwise
+/// @param conv Converter Context for the task size;
+/// @return Search function for the fragments;
+template<typename NodeNumber, typename Weight>
+typename FragmentSearch<NodeNumber, Weight>::Entry PickFragmentSearch(const ConverterContext<NodeNumber>& conv, const SearchInstance<Weight>&);
+FragmentSearch< uint64_t, FixedInt<1> >::Entry PickFragmentSearch(const ConverterContext<uint64_t>& conv, const SearchInstance< FixedInt<1> >&);
+
+/// Run the tree search over the fragment of a worker (stack engine).
+/// Visits the same nodes as SearchFragment(), but keeps the packing as the
+/// packed mask and the weights of all its prefixes in a per-depth array.
+/// The fragment is split into whole subtrees, walked with no node range check.
+/// With a leaf block of k items, a node whose last item is n-k-1 is resolved
+/// at once: its 2^k-1 descendants are matched against the tail sum table.
+/// @tparam NodeNumber Node number type wide enough for the task size;
+/// @tparam Weight     Weight type wide enough for the element size;
+/// @param wk Worker holding the fragment bounds;
+/// @param in Instance (worker's copy);
+/// @param conv Converter Context for the task size (the pieces are unranked through its radix table);
+/// @param st Work areas of the worker; accumulates the results;
+template<typename NodeNumber, typename Weight>
+void SearchFragmentStack(Worker* wk, const SearchInstance<Weight>& in, const ConverterContext<NodeNumber>& conv,
+                         SearchState<NodeNumber, Weight>* st);
 
-/// Calculate the weight of the tree branch rooted on the node with given mask
-/// @param ts   Task Size (Knapsack Vector length);
-/// @param mask Packing vector of the subtree root;
-/// @return Node count for this subtree;
-NTL::ZZ WeighBranch(int ts, NTL::vec_GF2 mask);
+/// Count the solutions of the whole instance by meeting in the middle (Horowitz-Sahni).
+/// The subset sums of both halves of the Knapsack vector are sorted
+/// and the pairs adding up to w are counted by a two-pointer merge.
+/// Like the tree engines, a packing counts only when its last item weighs more
+/// than zero, so the right half takes part with such subsets alone and the
+/// packings that leave it empty are counted on the left list beforehand.
+/// @tparam NodeNumber Counter type wide enough for the task size;
+/// @tparam Weight     Weight type wide enough for the element size;
+/// @param wk Worker receiving the results;
+/// @param in Instance (worker's copy);
+template<typename NodeNumber, typename Weight>
+void SearchMITM(Worker* wk, const SearchInstance<Weight>& in);
+
+/// Run the tree search over the fragment of a worker (octal engine).
+/// The packing is held as the octal digits of its literal string (see
+/// converter.h), and the weight as prefix sums over the 3-item groups, so a
+/// step replaces one digit and looks its weight up in an 8-entry table. A node
+/// whose last item closes a group roots a subtree made of all the digit
+/// combinations of the groups below; such subtrees are counted group by group,
+/// comparing all the 8 digit sums of a group with the remaining weight at once.
+/// @tparam NodeNumber Node number type wide enough for the task size;
+/// @tparam Weight     Weight type wide enough for the element size;
+/// @param wk Worker holding the fragment bounds;
+/// @param in Instance (worker's copy);
+/// @param conv Converter Context for the task size;
+/// @param st Work areas of the worker; accumulates the results;
+template<typename NodeNumber, typename Weight>
+void SearchFragmentOctal(Worker* wk, const SearchInstance<Weight>& in, const ConverterContext<NodeNumber>& conv,
+                         SearchState<NodeNumber, Weight>* st);
+
+/// Count the solutions of the whole instance by the Schroeppel-Shamir algorithm.
+/// The Knapsack vector is split into quarters A, B, C, D. The sums a+b are
+/// streamed in ascending order and the sums c+d in descending order, each by a
+/// heap holding one cursor per entry of the A (resp. C) list, so the memory
+/// stays O(2^(n/4)) while the merge takes O(2^(n/2)) heap steps. As in
+/// SearchMITM(), only the packings whose last item weighs more than zero count:
+/// the c+d stream holds the pairs ending with such an item, and the packings
+/// with no item in C or D are counted before the merge.
+/// @tparam NodeNumber Counter type wide enough for the task size;
+/// @tparam Weight     Weight type wide enough for the element size;
+/// @param wk Worker receiving the results;
+/// @param in Instance (worker's copy);
+template<typename NodeNumber, typename Weight>
+void SearchSS(Worker* wk, const SearchInstance<Weight>& in);
+
+/// Run the exhaustive search over the fragment of a worker (Gray code engine).
+/// The fragment is taken as a range of reflected Gray code indices rather than
+/// tree nodes: index i stands for the packed mask i ^ (i >> 1), so the step to
+/// i + 1 flips the item of the lowest set bit of i + 1 and costs one addition or
+/// subtraction. No branch is pruned. A packing of weight w counts when its last
+/// item weighs more than zero, which matches the stop-at-first-hit rule of the
+/// tree engines.
+/// @tparam NodeNumber Index type wide enough for the task size;
+/// @tparam Weight     Weight type wide enough for the element size;
+/// @param wk Worker holding the fragment bounds;
+/// @param in Instance (worker's copy);
+/// @param st Work areas of the worker; accumulates the results;
+template<typename NodeNumber, typename Weight>
+void SearchFragmentGray(Worker* wk, const SearchInstance<Weight>& in, const ConverterContext<NodeNumber>&,
+                        SearchState<NodeNumber, Weight>* st);
+
+/// Count the solutions strictly below a node whose last item closes a group
+/// @param in    Instance (worker's copy);
+/// @param first The first group below the node;
+/// @param c     Weight of the node (below w);
+/// @param base  Work area of GroupCount weights;
+/// @param pending Work area of GroupCount digit masks;
+/// @param[in,out] steps Counter for the groups expanded;
+/// @param[in,out] visited Counter for the subtree nodes whose weight was looked at (the node itself excluded);
+/// @param[in,out] over_pruned  Counter for the nodes below the digits of weight >= w;
+/// @param[in,out] bound_pruned Counter for the nodes below the digits cut by the suffix sum bound (-o);
+/// @param wk    Worker recording the solutions (0 to count only);
+/// @param plit  Packed literal string of the node (recording; restored on return);
+/// @param found Work area of a packed mask (recording);
+/// @return Number of solutions (up to the first group hitting w with --first);
+template<typename NodeNumber, typename Weight>
+static long CountOctalSubtree(const SearchInstance<Weight>& in, int first, const Weight& c, Weight* base, unsigned* pending, long* steps,
+                              NodeNumber* visited, NodeNumber* over_pruned, NodeNumber* bound_pruned,
+                              Worker* wk, uint64_t* plit, uint64_t* found);
+
+/// Record the solutions ending with the given digits at a level of the packed literal string
+static void PutOctalSolutions(Worker* wk, uint64_t* plit, uint64_t* found, unsigned int level, unsigned int digits);
+
+/// Fill the list with the weights of all the subsets of the given items
+/// @param[out] list  Subset sums, bit i of the index for items[i];
+/// @param      items Items to combine;
+/// @param      count Number of the items;
+template<typename Weight>
+static void ListSubsetSums(std::vector<Weight>& list, const Weight* items, int count);
+
+/// Move the subsets a search counts to the front of a ListSubsetSums() list:
+/// those ending with an item that weighs more than zero (see SearchFragmentGray()).
+/// The empty subset and the ones ending with a zero weight item follow.
+/// @param list  Subset sums of the items, partitioned in place;
+/// @param buf   Work area;
+/// @param items Items the list was built of;
+/// @param count Number of the items;
+/// @return Number of the subsets moved to the front;
+template<typename Weight>
+static size_t PartitionCountableSums(std::vector<Weight>& list, std::vector<Weight>& buf, const Weight* items, int count);
+
+/// Answer a pending steal request with the upper half of the unvisited nodes.
+/// The bounds are split in the node number type of the search and written
+/// into the fragment bounds in place (see the iteration setup in main()).
+/// @tparam NodeNumber Node number type of the search;
+/// @param wk          Busy worker (victim);
+/// @param CurrentNode The first node the victim has not visited yet;
+/// @param[in,out] frag_end Last node of the victim's fragment; lowered on a grant;
+/// @return true if the thief got a part of the fragment, false if the rest is too small to split;
+template<typename NodeNumber>
+bool ShareFragment(Worker* wk, const NodeNumber& CurrentNode, NodeNumber* frag_end);
+
+/// Mark the worker idle once its fragment is exhausted and refuse a pending thief
+/// @param wk Worker that finished its fragment;
+void RetireWorker(Worker* wk);
+
+/// Take over the upper half of some busy worker's fragment
+/// @param wk   Idle worker (thief); receives the new fragment bounds;
+/// @param pool All the workers of the iteration;
+/// @return false when the whole tree is drained;
+bool StealFragment(Worker* wk, std::vector<Worker>* pool);
+
+/// Skip a pruned branch within the batch of unranked nodes
+/// @param[in,out] pos  Current node in the batch; set to len when the branch runs past the batch;
+/// @param len  Batch length;
+/// @param exp  Branch size exponent (the branch holds 2^exp nodes);
+void SkipBatch(unsigned int* pos, unsigned int len, int exp);
 
 #ifdef _DEBUG
 #define PrintPCKDebug(pck, msg) do { PrintPCK(pck, msg); } while (0)
 
-void PrintPCK(NTL::vec_GF2 pck, const char* msg)
+void PrintPCK(const uint64_t* pck, const char* msg)
 {
     if (msg != nullptr)
     {
         printf("%s: \n", msg);
     }
 
-    for (auto i: pck)
+    for (int i = 0; i < cfg.TaskSize; i++)
     {
-        printf("%u", i==1 ? 1 : 0);
+        printf("%u", GetPackedItem(cfg.TaskSize, pck, i) ? 1 : 0);
     }
     printf("\n");
 }
@@ -70,19 +640,18 @@ void PrintPCK(NTL::vec_GF2 pck, const char* msg)
 #define PrintPCKDebug(pck, msg) do { } while (0)
 #endif
 
+/* The packing moves over the packed mask pck (see converter.h) of ts items: the last item is its lowest set bit.
+   GoSide leaves an empty packing alone: it has no sibling, the whole tree is behind CurrentNode and the loop ends */
 #define GoSide(knp, pck, c) \
 do { \
     PrintPCKDebug(pck, "GoSide"); \
-    for (auto i = cfg.TaskSize-1; i >= 0; i--) \
+    int i = GetLastPackedItem(ts, pck); \
+    if (i >= 0) \
     { \
-        if (pck.get(i) == 1) \
-        { \
-            pck.put(i, 0); \
-            NTL::add(c, c, -knp.get(i)); \
-            pck.put(i+1, 1); \
-            NTL::add(c, c, knp.get(i+1)); \
-            break; \
-        } \
+        FlipPackedItem(ts, pck, i); \
+        SubWeight(c, knp[i]); \
+        FlipPackedItem(ts, pck, i+1); \
+        AddWeight(c, knp[i+1]); \
     } \
     PrintPCKDebug(pck, nullptr); \
 } while (0)
@@ -90,8 +659,8 @@ do { \
 #define GoBack(knp, pck, c) \
 do { \
     PrintPCKDebug(pck, "GoBack"); \
-    pck.put(cfg.TaskSize-1, 0); \
-    NTL::add(c, c, -knp.get(cfg.TaskSize-1)); \
+    FlipPackedItem(ts, pck, ts-1); \
+    SubWeight(c, knp[ts-1]); \
     PrintPCKDebug(pck, nullptr); \
     GoSide(knp, pck, c); \
 } while (0)
@@ -99,20 +668,9 @@ do { \
 #define GoForward(knp, pck, c) \
 do { \
     PrintPCKDebug(pck, "GoForward"); \
-    for (auto i = cfg.TaskSize-1; i >= 0; i--) \
-    { \
-        if (pck.get(i) == 1) \
-        { \
-            pck.put(i+1, 1); \
-            NTL::add(c, c, knp.get(i+1)); \
-            break; \
-        } \
-        if (i == 0) \
-        { \
-            pck.put(0, 1); \
-            NTL::add(c, c, knp.get(0)); \
-        } \
-    } \
+    int i = GetLastPackedItem(ts, pck); \
+    FlipPackedItem(ts, pck, i+1); \
+    AddWeight(c, knp[i+1]); \
     PrintPCKDebug(pck, nullptr); \
 } while (0)
 
@@ -135,23 +693,130 @@ int main(int argc, char* argv[])
         if(mode == 3) {cfg.ProcCount            = atoi(argv[a]); mode = 0; continue;}
         if(mode == 4) {cfg.IterCount            = atoi(argv[a]); mode = 0; continue;}
         if(mode == 5) {cfg.RelativeTargetWeight = atoi(argv[a]); mode = 0; continue;}
+        if(mode == 7) {cfg.LeafBlock            = atoi(argv[a]); mode = 0; continue;}
+        if(mode == 8) {cfg.RadixBits            = atoi(argv[a]); mode = 0; continue;}
+        if(mode == 9) {cfg.ProbeCount           = atoi(argv[a]); mode = 0; continue;}
+        if(mode == 10 || mode == 11) {cfg.SolutionFile = argv[a]; Sink.Json = mode == 11; mode = 0; continue;}
+        if(mode == 6)
+        {
+            int e = 0;
+            while(e < Engine_COUNT && strcmp(argv[a], EngineNames[e])) e++;
+            if(e == Engine_COUNT) {PrintError(argv[a]); return(-1);}
+            cfg.Engine = (EngineType)e; mode = 0; continue;
+        }
 
         if(!strcmp(argv[a],"-n")) {mode = 1; continue;}
         if(!strcmp(argv[a],"-m")) {mode = 2; continue;}
         if(!strcmp(argv[a],"-p")) {mode = 3; continue;}
         if(!strcmp(argv[a],"-i")) {mode = 4; continue;}
         if(!strcmp(argv[a],"-r")) {mode = 5; continue;}
+        if(!strcmp(argv[a],"-e")) {mode = 6; continue;}
+        if(!strcmp(argv[a],"-k")) {mode = 7; continue;}
+        if(!strcmp(argv[a],"-x")) {mode = 8; continue;}
+        if(!strcmp(argv[a],"-t")) {mode = 9; continue;}
+        if(!strcmp(argv[a],"-f")) {mode = 10; continue;}
+        if(!strcmp(argv[a],"-j")) {mode = 11; continue;}
 
         if(!strcmp(argv[a],"-o")) {cfg.OptimizedAlgorithm = true; mode = 0; continue;}
+        if(!strcmp(argv[a],"-s")) {cfg.WorkStealing       = true; mode = 0; continue;}
+        if(!strcmp(argv[a],"--count-allocs")) {cfg.CountAllocs = true; mode = 0; continue;}
+        if(!strcmp(argv[a],"--ranks")) {Sink.Ranks = true; mode = 0; continue;}
+        if(!strcmp(argv[a],"--first")) {cfg.FirstSolution = true; mode = 0; continue;}
+        if(!strcmp(argv[a],"--self-test")) return RunSelfTest(false);
+        if(!strcmp(argv[a],"--self-test-all")) return RunSelfTest(true);
 
         PrintError(argv[a]);
         return(-1);
     }
     if(mode != 0) {PrintError(argv[argc-1]); return(-1);}
+#if !defined(KT_COUNT_ALLOCS)
+    if(cfg.CountAllocs)
+    {
+        printf("--count-allocs needs a build with -D KT_COUNT_ALLOCS (glibc);\n");
+        return(-1);
+    }
+#endif
+    if(cfg.Engine == Engine_MITM && cfg.TaskSize > MaxMITMTaskSize)
+    {
+        printf("The mitm engine takes task sizes up to %i;\n", MaxMITMTaskSize);
+        return(-1);
+    }
+    if(cfg.Engine == Engine_SS && cfg.TaskSize > MaxSSTaskSize)
+    {
+        printf("The ss engine takes task sizes up to %i;\n", MaxSSTaskSize);
+        return(-1);
+    }
+    if(cfg.LeafBlock != 0 && (cfg.LeafBlock < MinLeafBlock || cfg.LeafBlock > MaxLeafBlock || cfg.LeafBlock >= cfg.TaskSize))
+    {
+        printf("The leaf block takes %i to %i items, fewer than the task size;\n", MinLeafBlock, MaxLeafBlock);
+        return(-1);
+    }
+    if(cfg.LeafBlock != 0 && cfg.Engine != Engine_STACK)
+    {
+        printf("The leaf block is resolved by the stack engine only;\n");
+        return(-1);
+    }
+    if(cfg.RadixBits < 1 || cfg.RadixBits > (int)MaxRadixBits)
+    {
+        printf("The radix digits take 1 to %i bits;\n", (int)MaxRadixBits);
+        return(-1);
+    }
+    bool whole_instance = cfg.Engine == Engine_MITM || cfg.Engine == Engine_SS;
+    if(cfg.ProbeCount < 0 || (cfg.ProbeCount > 0 && (!cfg.OptimizedAlgorithm || whole_instance || cfg.Engine == Engine_GRAY)))
+    {
+        printf("The tree size estimates take a positive probe count and a pruning tree engine (-o; macro, stack, octal);\n");
+        return(-1);
+    }
+    bool estimate = cfg.ProbeCount > 0;
+    if((cfg.SolutionFile || cfg.FirstSolution) && whole_instance)
+    {
+        printf("The solutions are recorded and the first one is stopped at by the tree and gray engines;\n");
+        return(-1);
+    }
+    if(cfg.SolutionFile)
+    {
+        Sink.File = fopen(cfg.SolutionFile, Sink.Json ? "w" : "wb");
+        if(!Sink.File)
+        {
+            printf("Cannot open the solution file: %s;\n", cfg.SolutionFile);
+            return(-1);
+        }
+        Sink.Record = true;
+    }
+    Sink.Enabled = Sink.Record || cfg.FirstSolution;
+    First.Mask.resize(GetPackedMaskSize(cfg.TaskSize));
 
     /* Initialize the pseudorandom number generator */
     srand(clock() * time(NULL));
 
+    /* Pick the narrowest node number type for the task size */
+    /* and the narrowest weight type for the element size */
+    /* The converter context of that type is shared by all the workers */
+    WorkerEntry worker_entry;
+    const char* node_type;
+    const char* weight_type;
+    std::unique_ptr< ConverterContext<uint64_t> > conv64;
+    std::unique_ptr< ConverterContext<uint128_t> > conv128;
+    std::unique_ptr< ConverterContext<NTL::ZZ> > convZZ;
+    if(cfg.TaskSize <= (int)NodeLimit<uint64_t>::MaxTaskSize)
+    {
+        conv64.reset(new ConverterContext<uint64_t>(cfg.TaskSize, cfg.RadixBits));
+        worker_entry = PickWorkerEntry<uint64_t>(cfg.ElementSize, &weight_type, *conv64);
+        node_type = "64-bit";
+    }
+    else if(cfg.TaskSize <= (int)NodeLimit<uint128_t>::MaxTaskSize)
+    {
+        conv128.reset(new ConverterContext<uint128_t>(cfg.TaskSize, cfg.RadixBits));
+        worker_entry = PickWorkerEntry<uint128_t>(cfg.ElementSize, &weight_type, *conv128);
+        node_type = "128-bit";
+    }
+    else
+    {
+        convZZ.reset(new ConverterContext<NTL::ZZ>(cfg.TaskSize, cfg.RadixBits));
+        worker_entry = PickWorkerEntry<NTL::ZZ>(cfg.ElementSize, &weight_type, *convZZ);
+        node_type = "NTL::ZZ";
+    }
+
     /* Print the experiment parameters */
     time (&rawtime);
     timeinfo = localtime (&rawtime);
@@ -159,16 +824,35 @@ int main(int argc, char* argv[])
            "---> Task size:       %i;\n"
            "---> Element size:    %i;\n"
            "---> Processor Count: %i;\n"
+           "---> Node numbers:    %s;\n"
+           "---> Weights:         %s;\n"
            "---> Iteration Count: %i;\n"
            "---> Using optimized algorithm: %s;\n"
+           "---> Using work stealing: %s;\n"
+           "---> Search engine:   %s;\n"
+           "---> Leaf block:      %i;\n"
+           "---> Radix bits:      %i;\n"
+           "---> Knuth probes:    %i;\n"
+           "---> Solution sink:   %s;\n"
+           "---> Stop at the first solution: %s;\n"
            "---> Fixed relative target weight, %: %i;\n"
            "---> Codebase Date:   25-10-2021;\n"
            "---> Experiment Date: %02i-%02i-%4i;\n",
            cfg.TaskSize,
            cfg.ElementSize,
            cfg.ProcCount,
+           node_type,
+           weight_type,
            cfg.IterCount,
            cfg.OptimizedAlgorithm ? "Yes" : "No",
+           cfg.WorkStealing ? "Yes" : "No",
+           EngineNames[cfg.Engine],
+           cfg.LeafBlock,
+           cfg.RadixBits,
+           cfg.ProbeCount,
+           !Sink.Record ? "None" : Sink.Json ? (Sink.Ranks ? "JSON lines of ranks" : "JSON lines of masks")
+                                              : (Sink.Ranks ? "binary ranks" : "binary masks"),
+           cfg.FirstSolution ? "Yes" : "No",
            cfg.RelativeTargetWeight,
            timeinfo->tm_mday,
            timeinfo->tm_mon+1,
@@ -186,31 +870,67 @@ int main(int argc, char* argv[])
 
     /* Definition of the Knapsack Problem */
     NTL::vec_ZZ  knp;   //< The Knapsack vector (item weights);
-    NTL::vec_GF2 pck;   //< The packing vector (1 = include item; 0 = don't);
     NTL::ZZ      w;     //< Target weight;
 
     /* Per-processor data */
-    NTL::ZZ c;           //< Buffer for the current packing weight;
+    std::vector<Worker>      workers(cfg.ProcCount);    //< Work areas and results of the workers;
+    std::vector<std::thread> threads(cfg.ProcCount);    //< Worker threads;
 
     /* Performance counters */
     NTL::ZZ solutions_total;    //< Counter for found solutions;
-    NTL::ZZ nodes_total;        //< Counter for checked nodes (packings);
+    NTL::ZZ visited_total;      //< Counter for visited nodes;
+    NTL::ZZ over_total;         //< Counter for nodes pruned by the weight;
+    NTL::ZZ bound_total;        //< Counter for nodes pruned by the suffix sum bound;
+    NTL::ZZ leaf_total;         //< Counter for nodes resolved by the leaf block lookups;
+    NTL::ZZ groups_total;       //< Counter for digit groups expanded by the octal engine;
+    float   wall_msec;          //< Wall-clock makespan of an iteration (msec);
+    float   part_msec;          //< Time spent on the cost estimates (msec);
+    double  est_total;          //< Estimated visited nodes of the whole tree;
+
+    /* Random source of the Knuth probes (kept apart from the instance generator) */
+    std::mt19937_64 probe_rng;
 
     /* Initialize the Knapsack Problem Instance */
     knp.SetLength(cfg.TaskSize,NTL::ZZ(0));  //< Initialize the Knapsack vector;
-    pck.SetLength(cfg.TaskSize,NTL::GF2(0)); //< Initialize a packing vector;
 
-    DomainType* lit = (DomainType*)malloc((unsigned long)((cfg.TaskSize/3+3) *
-                      sizeof(DomainType)));
-    InitializeDomainSizeCache(cfg.TaskSize);
+    /* Count the nodes in subtasks, one per worker */
+    NTL::ZZ TreeSize;
+    NTL::power(TreeSize, 2, cfg.TaskSize);
+    NTL::ZZ InitialFragSize = TreeSize / cfg.ProcCount;
+    for(int j=0; j<cfg.ProcCount; j++)
+        workers[j].Rank = j;
 
     /* Format the output table header */
     printf("ITER   |");
     printf("RELW, %%|");
-    for(int j=0; j<cfg.ProcCount; j++) printf("Time,ms|");
+    for(int j=0; j<cfg.ProcCount; j++) printf(estimate ? "Time,ms|Est,ms |" : "Time,ms|");
+    printf("Wall,ms|");
+    if(estimate) printf("Part,ms|");
+    printf("Solutions|");
+    printf("Visited  |");
+    if(estimate) printf("EstVisit |");
+    if(cfg.WorkStealing) printf("Steals |");
+    if(cfg.OptimizedAlgorithm) printf("OverCut  |BoundCut |");
+    if(cfg.LeafBlock > 0) printf("LeafCut  |");
+    if(cfg.Engine == Engine_OCTAL) printf("Groups   |");
+    if(whole_instance) printf("Mem,KB   |");
+    if(cfg.CountAllocs) printf("Alloc/M  |");
+    if(cfg.FirstSolution) printf("First,ms |First packing");
     printf("\n");
     printf("-------x");
-    printf("-------x"); for(int j=0; j<cfg.ProcCount; j++) printf("-------x");
+    printf("-------x"); for(int j=0; j<cfg.ProcCount; j++) printf(estimate ? "-------x-------x" : "-------x");
+    printf("-------x");
+    if(estimate) printf("-------x");
+    printf("---------x");
+    printf("---------x");
+    if(estimate) printf("---------x");
+    if(cfg.WorkStealing) printf("-------x");
+    if(cfg.OptimizedAlgorithm) printf("---------x---------x");
+    if(cfg.LeafBlock > 0) printf("---------x");
+    if(cfg.Engine == Engine_OCTAL) printf("---------x");
+    if(whole_instance) printf("---------x");
+    if(cfg.CountAllocs) printf("---------x");
+    if(cfg.FirstSolution) printf("---------x-------------");
     printf("\n");
 
     for(int iter = 0; iter < cfg.IterCount; iter++)
@@ -221,8 +941,31 @@ int main(int argc, char* argv[])
 
         if(cfg.OptimizedAlgorithm == true)
         {
-            // Sort descending knapsack vector
-            std::sort(knp.begin(), knp.end(), std::greater<NTL::ZZ>());
+            // Sort descending knapsack vector, keeping the original place of every item
+            std::vector<int>& order = Sink.Order;
+            order.resize(cfg.TaskSize);
+            for(int j=0; j<cfg.TaskSize; j++) order[j] = j;
+            std::stable_sort(order.begin(), order.end(), [&knp](int a, int b) { return knp[a] > knp[b]; });
+            NTL::vec_ZZ sorted;
+            sorted.SetLength(cfg.TaskSize);
+            for(int j=0; j<cfg.TaskSize; j++) sorted[j] = knp[order[j]];
+            knp = sorted;
+
+            /* Tabulate the original places of the items of every mask byte */
+            unsigned int words = GetPackedMaskSize(cfg.TaskSize);
+            Sink.Scatter.clear();
+            if(Sink.Enabled && words <= MaxScatterWords)
+            {
+                Sink.Scatter.assign(size_t(8 * words) * 256 * words, 0);
+                for(int j=0; j<cfg.TaskSize; j++)
+                {
+                    /* Searched item j is mask bit n-1-j; byte p holds bits 8p to 8p+7 */
+                    int bit = cfg.TaskSize - 1 - j;
+                    uint64_t* table = &Sink.Scatter[size_t(bit / 8) * 256 * words];
+                    for(int v=0; v<256; v++)
+                        if((v >> (bit % 8)) & 1) FlipPackedItem(cfg.TaskSize, &table[v * words], order[j]);
+                }
+            }
         }
 
         /* Get the sum of all Knapsack elements */
@@ -248,150 +991,124 @@ int main(int argc, char* argv[])
             w = relw * sum_ai / 100;
         }
 
+        Sink.Complement = false;
         if(cfg.OptimizedAlgorithm == true)
         {
             if(2 * w > sum_ai)
             {
                 w = sum_ai - w;
+                Sink.Complement = true;
             }
         }
+        Sink.Iteration = iter;
 
         /* Initialize an iteration */
         printf("I:%5i| ", iter);
         printf("%6i| ", NTL::to_uint(relw));
         solutions_total = 0;
-        nodes_total = 0;
+        visited_total = 0;
+        over_total = 0;
+        bound_total = 0;
+        leaf_total = 0;
+        groups_total = 0;
 
-        /* Start the algorithm for each of the processors */
-        for(ProcRank=0; ProcRank < cfg.ProcCount; ProcRank++)
+        /* Split the tree into fragments; the last one takes the remainder of the division */
+        for(int j=0; j<cfg.ProcCount; j++)
         {
-            /* Start the experiment clock */
-            clck = clock();
-
-            /* Count the nodes in subtasks */
-            NTL::ZZ InitialFragSize;
-            NTL::power(InitialFragSize, 2, cfg.TaskSize);
-            InitialFragSize /= cfg.ProcCount;
-
-            /* Calculate the number of the first packing to check */
-            NTL::ZZ frag_start; frag_start = ProcRank * InitialFragSize;
-            /* Calculate the number of the last packing to check */
-            NTL::ZZ frag_end;   frag_end = frag_start + InitialFragSize - 1;
-
-            /* Set the current node to the start of the work area */
-            NTL::ZZ CurrentNode = NTL::ZZ(frag_start);
-            NTL::ZZ current_pool = NTL::ZZ(InitialFragSize);
-
-            /* Buffer for storing the node count in a branch */
-            NTL::ZZ branch_size = NTL::ZZ(0);
+            workers[j].FragStart = j * InitialFragSize;
+            workers[j].FragEnd = workers[j].FragStart + InitialFragSize - 1;
+            workers[j].Busy = true;
+            workers[j].Thief = 0;
+            workers[j].StealRequest = false;
+        }
+        workers[cfg.ProcCount-1].FragEnd = TreeSize - 1;
+        BusyWorkers = cfg.ProcCount;
 
-            /* Reset weight buffer */
-            c = 0;
+        /* Move the fragment bounds to equal estimated costs */
+        part_msec = 0;
+        est_total = 0;
+        if(estimate)
+        {
+            WallClock::time_point part_start = WallClock::now();
+            if(PartitionByEstimate(knp, w, workers, probe_rng))
+                for(int j=0; j<cfg.ProcCount; j++) est_total += workers[j].EstCost;
+            part_msec = std::chrono::duration<float, std::milli>(WallClock::now() - part_start).count();
+        }
 
-            if (cfg.OptimizedAlgorithm == true)
-            {
-                GetLiteralStringByNumber(cfg.TaskSize, lit, CurrentNode);
-                SetMaskByLiteralString(cfg.TaskSize, &pck, lit);
+        /* Give the fragment bounds room for any node number: a steal writes them in place */
+        for(int j=0; j<cfg.ProcCount; j++)
+        {
+            workers[j].FragStart.SetSize(GetPackedMaskSize(cfg.TaskSize));
+            workers[j].FragEnd.SetSize(GetPackedMaskSize(cfg.TaskSize));
+        }
 
-                for (int i = cfg.TaskSize-1; i>=0; i--)
-                    if(pck.get(i)==1)
-                    {
-                        NTL::add(c, c, knp.get(i));
-                    };
-            }
+        SolutionFound = false;
+        WallClock::time_point wall_start = WallClock::now();
+        IterationStart = wall_start;
+        for(int j=0; j<cfg.ProcCount; j++)
+            threads[j] = std::thread(worker_entry, &workers[j], &workers, std::cref(knp), std::cref(w));
+        for(int j=0; j<cfg.ProcCount; j++)
+            threads[j].join();
+        wall_msec = std::chrono::duration<float, std::milli>(WallClock::now() - wall_start).count();
 
-            /* Start the search */
-            while (CurrentNode <= frag_end)
+        /* Collect the results */
+        int steals_total = 0;
+        size_t peak_bytes = 0;
+        unsigned long allocs_total = 0;
+        float msec_total = 0;
+        for(int j=0; j<cfg.ProcCount; j++) msec_total += workers[j].Msec;
+        for(int j=0; j<cfg.ProcCount; j++)
+        {
+            peak_bytes = std::max(peak_bytes, workers[j].PeakBytes);
+            printf("%6.0f| ", workers[j].Msec);
+            /* The estimated share of the work times the total worker time */
+            if(estimate) printf("%6.0f| ", est_total > 0 ? workers[j].EstCost / est_total * msec_total : 0.0);
+            solutions_total += workers[j].Solutions;
+            visited_total += workers[j].Visited;
+            over_total += workers[j].OverPruned;
+            bound_total += workers[j].BoundPruned;
+            leaf_total += workers[j].LeafResolved;
+            groups_total += workers[j].GroupSteps;
+            steals_total += workers[j].Steals;
+            allocs_total += workers[j].Allocs;
+        }
+        printf("%6.0f| ", wall_msec);
+        if(estimate) printf("%6.0f| ", part_msec);
+        PrintZZ(solutions_total, 8);
+        PrintZZ(visited_total, 8);
+        if(estimate) printf("%8.3g| ", est_total);
+        if(cfg.WorkStealing) printf("%6i| ", steals_total);
+        if(cfg.OptimizedAlgorithm)
+        {
+            PrintZZ(over_total, 8);
+            PrintZZ(bound_total, 8);
+        }
+        if(cfg.LeafBlock > 0) PrintZZ(leaf_total, 8);
+        if(cfg.Engine == Engine_OCTAL) PrintZZ(groups_total, 8);
+        if(whole_instance) printf("%8lu| ", (unsigned long)(peak_bytes / 1024));
+        if(cfg.CountAllocs)
+        {
+            /* Allocations per million visited nodes */
+            double visited_m = NTL::conv<double>(visited_total) / 1e6;
+            printf("%8.2f| ", visited_m > 0 ? allocs_total / visited_m : (double)allocs_total);
+        }
+        if(cfg.FirstSolution)
+        {
+            /* Time to the first solution and its packed mask in the original item order */
+            if(SolutionFound)
             {
-                if(cfg.OptimizedAlgorithm == false)
-                {
-                    GetLiteralStringByNumber(cfg.TaskSize, lit, CurrentNode);
-                    SetMaskByLiteralString(cfg.TaskSize, &pck, lit);
-
-                    c = 0;
-                    for (int i = cfg.TaskSize-1; i>=0; i--)
-                        if(pck.get(i)==1)
-                        {
-                            NTL::add(c, c, knp.get(i));
-                        };
-                }
-
-                if(c < w)
-                {
-                    CurrentNode++;
-
-                    if (cfg.OptimizedAlgorithm == true)
-                    {
-                        if (pck[cfg.TaskSize-1] == 1)
-                        {
-                            GoBack(knp, pck, c);
-                        }
-                        else
-                        {
-                            GoForward(knp, pck, c);
-                        }
-                    }
-                    else
-                    {
-                        current_pool--;
-                    }
-                }
-                else if(c > w)
-                {
-                    branch_size = WeighBranch(cfg.TaskSize, pck);
-                    CurrentNode += branch_size;
-
-                    if (cfg.OptimizedAlgorithm == true)
-                    {
-                        if (pck[cfg.TaskSize-1] == 1)
-                        {
-                            GoBack(knp, pck, c);
-                        }
-                        else
-                        {
-                            GoSide(knp, pck, c);
-                        }
-                    }
-                    else
-                    {
-                        current_pool -= branch_size;
-                    }
-                }
-                else if(c == w)
-                {
-                    solutions_total++;
-                    branch_size = WeighBranch(cfg.TaskSize, pck);
-                    CurrentNode += branch_size;
-
-                    if(cfg.OptimizedAlgorithm == true)
-                    {
-                        if (pck[cfg.TaskSize-1] == 1)
-                        {
-                            GoBack(knp, pck, c);
-                        }
-                        else
-                        {
-                            GoSide(knp, pck, c);
-                        }
-                    }
-                    else
-                    {
-                        current_pool -= branch_size;   
-                    }
-                }
-
+                std::string mask;
+                AppendHexMask(mask, First.Mask.data(), (unsigned int)First.Mask.size());
+                printf("%8.2f| %s", First.Msec, mask.c_str());
             }
-
-            /* Stop the timer */
-            clck = clock() - clck;
-            clck_msec = ((float)clck) / CLOCKS_PER_SEC * 1000.0;
-            printf("%6.0f| ", clck_msec);
+            else printf("%8s| %s", "-", "-");
         }
 
         /* Finalize an iteration */
         printf("\n");
     }
 
+    if(Sink.File) fclose(Sink.File);
     return 0;
 }
 
@@ -404,6 +1121,167 @@ NTL::ZZ BigRandom(int bits)
     return(ret);
 }
 
+/* Knuth Tree-Size Estimates
+ *
+ * The optimized search visits every child of an alive node: one below the
+ * target weight that reaches it with all the items after its last one. With
+ * the items sorted descending, the alive children of a node are a run: the
+ * ones before it overshoot the target, the ones after it fall short of it.
+ * A probe walks from a subtree root down to a node without alive children.
+ * At every node it counts the other children as one node each and picks one
+ * alive child in proportion to its subtree size. The estimate of the visited
+ * nodes is 1 + D1 + C1*(1 + D2 + C2*(...)), where Di is the count of the other
+ * children and Ci the inverse probability of the pick (Knuth, 1975). The
+ * probes take the weights as doubles, scaled down to 60 bits if need be.
+ *
+ * The partitioner refines the tree into pieces, preorder ranges of whole
+ * subtrees and single nodes, by splitting the piece of the largest estimate
+ * until none is above 1/PiecesPerFragment of a fair share, and then cuts the
+ * list of pieces into runs of equal estimated cost. */
+
+/// A preorder range of the subset tree: a whole subtree, or its root alone
+struct TreePiece {
+    NTL::ZZ First;      ///< Number of the root node;
+    double  Weight;     ///< Weight of the root packing (scaled);
+    int     Last;       ///< Last item of the root packing (-1 for the tree root);
+    bool    Single;     ///< The range holds the root node only;
+    double  Cost;       ///< Estimated visited nodes;
+};
+
+/// The instance the probes run on: the weights as doubles
+struct ProbeInstance {
+    std::vector<double> Knp;        ///< Knapsack vector sorted descending;
+    std::vector<double> Suffix;     ///< Suffix sums of the Knapsack vector, Suffix[n] = 0;
+    double              W;          ///< Target weight;
+};
+
+/// Estimate the visited nodes of a subtree by one probe
+/// @param random Set if the probe picked a child at random (cleared otherwise);
+double ProbeSubtree(const ProbeInstance& in, int last, double c, std::mt19937_64& rng, bool* random)
+{
+    const int n = (int)in.Knp.size();
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    double est = 1, scale = 1;
+    *random = false;
+    while(last < n-1 && c < in.W && c + in.Suffix[last+1] >= in.W)
+    {
+        /* Alive children: from the first one below w to the last one that reaches w (not the last item) */
+        int lo = last + 1, hi = n;
+        while(lo < hi) { int mid = (lo + hi) / 2; if(c + in.Knp[mid] < in.W) hi = mid; else lo = mid + 1; }
+        int a = lo;
+        lo = last + 1; hi = n;
+        while(lo < hi) { int mid = (lo + hi) / 2; if(c + in.Suffix[mid] < in.W) hi = mid; else lo = mid + 1; }
+        int b = std::min(lo - 1, n - 2);
+
+        if(a > b) { est += scale * (n-1-last); break; }
+        est += scale * (n-1-last - (b-a+1));
+
+        /* Child j roots 2^(n-1-j) of the 2^(n-a) - 2^(n-1-b) nodes below the alive ones */
+        int j = a;
+        while(j < b && unit(rng) * (2.0 - ldexp(1.0, j-b)) >= 1.0) j++;
+        *random |= a < b;
+        scale *= ldexp(1.0, j+1-a) - ldexp(1.0, j-b);
+        est += scale;
+        c += in.Knp[j];
+        last = j;
+    }
+    return est;
+}
+
+/// Estimate the visited nodes of a piece by the mean of cfg.ProbeCount probes
+void EstimatePiece(TreePiece& piece, const ProbeInstance& in, std::mt19937_64& rng)
+{
+    piece.Cost = 1;
+    if(piece.Single) return;
+    double sum = 0;
+    bool random = true;
+    int i = 0;
+    /* A probe that never picked at random is exact */
+    for(; i < cfg.ProbeCount && random; i++)
+        sum += ProbeSubtree(in, piece.Last, piece.Weight, rng, &random);
+    piece.Cost = sum / i;
+}
+
+bool PartitionByEstimate(const NTL::vec_ZZ& knp, const NTL::ZZ& w, std::vector<Worker>& workers, std::mt19937_64& rng)
+{
+    const int n = knp.length();
+    const int p = (int)workers.size();
+
+    /* Scale the weights to doubles, keeping the top 60 bits of the sum */
+    NTL::ZZ sum; sum = 0;
+    for(int i = 0; i < n; i++) NTL::add(sum, sum, knp[i]);
+    long shift = std::max(0L, NTL::NumBits(sum) - 60);
+    ProbeInstance in;
+    in.Knp.resize(n);
+    in.Suffix.resize(n + 1);
+    in.Suffix[n] = 0;
+    for(int i = 0; i < n; i++) in.Knp[i] = NTL::conv<double>(knp[i] >> shift);
+    for(int i = n-1; i >= 0; i--) in.Suffix[i] = in.Suffix[i+1] + in.Knp[i];
+    in.W = NTL::conv<double>(w >> shift);
+
+    /* Start from the whole tree */
+    std::vector<TreePiece> pieces(1);
+    pieces[0].First = 0;
+    pieces[0].Weight = 0;
+    pieces[0].Last = -1;
+    pieces[0].Single = false;
+    EstimatePiece(pieces[0], in, rng);
+    double total = pieces[0].Cost;
+
+    /* Split the costliest subtree into its root and the subtrees of its children */
+    for(;;)
+    {
+        int top = -1;
+        for(int i = 0; i < (int)pieces.size(); i++)
+            if(!pieces[i].Single && pieces[i].Cost > 1 && (top < 0 || pieces[i].Cost > pieces[top].Cost))
+                top = i;
+        if(top < 0) break;
+        if((int)pieces.size() >= p && pieces[top].Cost * p * PiecesPerFragment <= total) break;
+
+        TreePiece root = pieces[top];
+        root.Single = true;
+        root.Cost = 1;
+        std::vector<TreePiece> split(1, root);
+        NTL::ZZ first = root.First + 1;
+        for(int j = root.Last + 1; j < n; j++)
+        {
+            TreePiece child;
+            child.First = first;
+            child.Weight = root.Weight + in.Knp[j];
+            child.Last = j;
+            child.Single = false;
+            EstimatePiece(child, in, rng);
+            split.push_back(child);
+            total += child.Cost;
+            first += NTL::power2_ZZ(n-1-j);
+        }
+        total += 1 - pieces[top].Cost;
+        pieces.erase(pieces.begin() + top);
+        pieces.insert(pieces.begin() + top, split.begin(), split.end());
+    }
+    if((int)pieces.size() < p) return false;
+
+    /* Cut after the piece that reaches the next share, leaving a piece to every later worker */
+    int next = 0;
+    double cost = 0;
+    for(int j = 0; j < p; j++)
+    {
+        workers[j].FragStart = pieces[next].First;
+        workers[j].EstCost = 0;
+        int end = (int)pieces.size() - (p - j);
+        while(next <= end)
+        {
+            workers[j].EstCost += pieces[next].Cost;
+            cost += pieces[next].Cost;
+            next++;
+            if(j < p-1 && cost >= total * (j+1) / p) break;
+        }
+        const TreePiece& tail = pieces[next-1];
+        workers[j].FragEnd = tail.Single ? tail.First : tail.First + NTL::power2_ZZ(n-1-tail.Last) - 1;
+    }
+    return true;
+}
+
 void PrintHelp()
 {
     printf("Command line switches:\n"
@@ -412,7 +1290,34 @@ void PrintHelp()
            "   -p [number]: Set processor count;                                def:   8\n"
            "   -i [number]: Set iterations count;                               def: 100\n"
            "   -r [number]: Set relative target weight of knapsack vector, %;   undef\n"
-           "   -o         : Use optimized algorithm\n");
+           "   -o         : Use optimized algorithm\n"
+           "   -s         : Let idle workers steal work from busy ones\n"
+           "   -e [name]  : Set search engine: macro, stack, mitm, ss, octal,\n"
+           "                gray;                                               def: macro\n"
+           "                (mitm and ss solve the whole instance on the first worker;\n"
+           "                gray visits every packing, the fragments being Gray code ranges)\n"
+           "   -k [number]: Resolve the last k items (3..8) as one block (stack\n"
+           "                engine; the block nodes are counted as LeafCut);   def:   0\n"
+           "   -x [number]: Set radix bits of the converter digits (1..16);     def:   8\n"
+           "   -t [number]: Cut fragments of equal cost estimated by the given\n"
+           "                number of Knuth probes per tree piece (-o; macro,\n"
+           "                stack, octal; 0 = equal node counts);              def:   0\n"
+           "   -f [file]  : Record the solutions to a binary file: packed masks of\n"
+           "                the original item order (see converter.h), (n+63)/64\n"
+           "                little-endian 64-bit words each, the iterations one\n"
+           "                after another (tree and gray engines)\n"
+           "   -j [file]  : Record the solutions to a JSON lines file instead\n"
+           "   --ranks    : Record node numbers instead of packed masks\n"
+           "   --first    : Stop all the workers at the first solution; report the\n"
+           "                time to it and its packed mask (tree and gray engines)\n"
+           "   --count-allocs: Report heap allocations of the search per million\n"
+           "                visited nodes (builds with -D KT_COUNT_ALLOCS)\n"
+           "   --self-test: Check the node number conversions against the literal\n"
+           "                strings and exit (every node of the small task sizes,\n"
+           "                samples of the large ones)\n"
+           "   --self-test-all: Check the packed mask rank and unrank against the\n"
+           "                literal strings on every node up to n = 30 and exit\n"
+           "                (takes long)\n");
     return;
 }
 
@@ -422,14 +1327,1775 @@ void PrintError(char* arg)
     return;
 }
 
-NTL::ZZ WeighBranch(int ts, NTL::vec_GF2 mask)
+void PrintZZ(const NTL::ZZ& value, int width)
+{
+    std::ostringstream str;
+    str << value;
+    printf("%*s| ", width, str.str().c_str());
+    return;
+}
+
+void AppendHexMask(std::string& text, const uint64_t* mask, unsigned int words)
+{
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%llx", (unsigned long long)mask[words - 1]);
+    text += buf;
+    for (int i = (int)words - 2; i >= 0; i--)
+    {
+        snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)mask[i]);
+        text += buf;
+    }
+    return;
+}
+
+void FlushSolutions(Worker* wk)
 {
-	NTL::ZZ ret; ret = 1;
-	for (int k = 0; mask[ts - k - 1] != NTL::GF2(1);)
-	{
-		ret *= 2;
-		k++;
-		if (k == ts) break;
-	}
-	return ret;
+    SolutionWriter& out = wk->Out;
+    if (out.Count == 0) return;
+
+    /* Format the JSON lines before taking the lock */
+    if (Sink.File && Sink.Json)
+    {
+        char buf[64];
+        out.Text.clear();
+        for (size_t r = 0; r < out.Count; r++)
+        {
+            const uint64_t* rec = &out.Records[r * out.Words];
+            snprintf(buf, sizeof(buf), "{\"iter\":%i,\"worker\":%i,\"%s\":\"", Sink.Iteration, wk->Rank, Sink.Ranks ? "rank" : "mask");
+            out.Text += buf;
+            if (Sink.Ranks)
+            {
+                /* Decimal node number */
+                std::ostringstream str;
+                str << NTL::ZZFromBytes((const unsigned char*)rec, out.Words * sizeof(uint64_t));
+                out.Text += str.str();
+            }
+            else AppendHexMask(out.Text, rec, out.Words);
+            out.Text += "\"}\n";
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(Sink.Lock);
+    if (Sink.Callback) Sink.Callback(wk->Rank, out.Records.data(), out.Count, out.Words);
+    if (Sink.File && Sink.Json) fwrite(out.Text.data(), 1, out.Text.size(), Sink.File);
+    if (Sink.File && !Sink.Json) fwrite(out.Records.data(), out.Words * sizeof(uint64_t), out.Count, Sink.File);
+    out.Count = 0;
+    return;
+}
+
+template<typename NodeNumber>
+WorkerEntry PickWorkerEntry(int ElementSize, const char** weight_type, const ConverterContext<NodeNumber>& conv)
+{
+    using namespace std::placeholders;
+    if(ElementSize <= WeightLimit< FixedInt<1> >::MaxElementSize) { *weight_type = "1x64-bit"; return std::bind(RunWorker<NodeNumber, FixedInt<1> >, _1, _2, _3, _4, std::cref(conv)); }
+    if(ElementSize <= WeightLimit< FixedInt<2> >::MaxElementSize) { *weight_type = "2x64-bit"; return std::bind(RunWorker<NodeNumber, FixedInt<2> >, _1, _2, _3, _4, std::cref(conv)); }
+    if(ElementSize <= WeightLimit< FixedInt<4> >::MaxElementSize) { *weight_type = "4x64-bit"; return std::bind(RunWorker<NodeNumber, FixedInt<4> >, _1, _2, _3, _4, std::cref(conv)); }
+    if(ElementSize <= WeightLimit< FixedInt<8> >::MaxElementSize) { *weight_type = "8x64-bit"; return std::bind(RunWorker<NodeNumber, FixedInt<8> >, _1, _2, _3, _4, std::cref(conv)); }
+    *weight_type = "NTL::ZZ";
+    return std::bind(RunWorker<NodeNumber, NTL::ZZ>, _1, _2, _3, _4, std::cref(conv));
+}
+
+template<typename NodeNumber, typename Weight>
+void RunWorker(Worker* wk, std::vector<Worker>* pool, const NTL::vec_ZZ& knp, const NTL::ZZ& w,
+               const ConverterContext<NodeNumber>& conv)
+{
+    /* Start the worker clock */
+    WallClock::time_point clck = WallClock::now();
+
+    wk->Solutions = 0;
+    wk->Visited = 0;
+    wk->OverPruned = 0;
+    wk->BoundPruned = 0;
+    wk->LeafResolved = 0;
+    wk->GroupSteps = 0;
+    wk->Steals = 0;
+    wk->PeakBytes = 0;
+    wk->Allocs = 0;
+
+    /* Take a private copy of the instance in the weight type of the engine */
+    SearchInstance<Weight> in;
+    in.Knp.resize(cfg.TaskSize);
+    for (int i = 0; i < cfg.TaskSize; i++)
+        in.Knp[i] = WeightFromZZ<Weight>(knp[i]);
+    in.W = WeightFromZZ<Weight>(w);
+
+    /* Precompute the weight of all the items from the given one to the last */
+    in.Suffix.resize(cfg.TaskSize + 1);
+    in.Suffix[cfg.TaskSize] = 0;
+    for (int i = cfg.TaskSize - 1; i >= 0; i--)
+    {
+        in.Suffix[i] = in.Suffix[i + 1];
+        AddWeight(in.Suffix[i], in.Knp[i]);
+    }
+
+    /* Precompute the subset sums of the leaf block. Within a tree branch the
+     * search stops at the first packing of weight w, so a tail subset ending
+     * with a zero weight item never counts: its entry is reset to 0, which
+     * never matches a positive remainder w - c (and neither does the empty one). */
+    if (cfg.LeafBlock > 0)
+    {
+        int first = cfg.TaskSize - cfg.LeafBlock;
+        ListSubsetSums(in.LeafSums, in.Knp.data() + first, cfg.LeafBlock);
+        Weight zero; zero = 0;
+        for (int j = 1; j < (1 << cfg.LeafBlock); j++)
+            if (in.Knp[first + 31 - __builtin_clz(j)] == zero) in.LeafSums[j] = 0;
+    }
+
+    /* Precompute the digit tables of the octal engine */
+    if (cfg.Engine == Engine_OCTAL)
+    {
+        in.GroupPad = GetTopDomainReductionRate(cfg.TaskSize);
+        in.GroupCount = (cfg.TaskSize + in.GroupPad) / 3;
+        in.DigitSums.resize(in.GroupCount * 8);
+        in.GroupSuffix.resize(in.GroupCount + 1);
+        in.DigitValid.resize(in.GroupCount);
+        in.DigitCountable.resize(in.GroupCount);
+        Weight zero; zero = 0;
+        for (int g = 0; g < in.GroupCount; g++)
+        {
+            in.DigitValid[g] = 0;
+            in.DigitCountable[g] = 0;
+            for (int d = 0; d < 8; d++)
+            {
+                in.DigitSums[8*g + d] = 0;
+                bool valid = true;
+                for (int b = 0; b < 3; b++)
+                {
+                    if (!(d & (1 << b))) continue;
+                    int item = 3*g + b - in.GroupPad;
+                    if (item < 0) { valid = false; continue; }
+                    AddWeight(in.DigitSums[8*g + d], in.Knp[item]);
+                }
+                if (!valid) continue;
+                in.DigitValid[g] |= 1 << d;
+                /* See the leaf block above: a packing ending with a zero weight item never counts */
+                if (d != 0 && !(in.Knp[3*g + 31 - __builtin_clz(d) - in.GroupPad] == zero))
+                    in.DigitCountable[g] |= 1 << d;
+            }
+        }
+        in.GroupSuffix[in.GroupCount] = 0;
+        for (int g = in.GroupCount - 1; g >= 0; g--)
+        {
+            in.GroupSuffix[g] = in.GroupSuffix[g + 1];
+            AddWeight(in.GroupSuffix[g], in.DigitSums[8*g + (in.DigitValid[g] & 0x80 ? 7 : (in.DigitValid[g] & 0x40 ? 6 : 4))]);
+        }
+    }
+
+    /* Buffer a batch of solution records */
+    wk->Out.Count = 0;
+    wk->Out.Words = GetPackedMaskSize(cfg.TaskSize);
+    wk->Out.Rank = Sink.Ranks ? RankSolution<NodeNumber> : 0;
+    if (Sink.Enabled) wk->Out.Records.resize(SolutionBatch * wk->Out.Words);
+
+    /* Size the work areas of the fragment searches for the task */
+    const int ts = cfg.TaskSize;
+    const unsigned int words = GetPackedMaskSize(ts);
+    SearchState<NodeNumber, Weight> st;
+    st.Solutions = 0;
+    st.Visited = 0;
+    st.OverPruned = 0;
+    st.BoundPruned = 0;
+    st.LeafResolved = 0;
+    st.GroupSteps = 0;
+    st.Mask.resize(words);
+    switch (cfg.Engine)
+    {
+    case Engine_MACRO:
+        if (!cfg.OptimizedAlgorithm)
+        {
+            st.Batch.resize(UnrankBatchSize * words);
+            st.BatchWeights.resize(UnrankBatchSize);
+        }
+        break;
+    case Engine_STACK:
+        st.Sums.resize(ts + 1);
+        if (Sink.Enabled) st.Found.resize(words);
+        /* Room for the pieces of any range (see SplitNodeRange()); NTL::ZZ numbers allocate anyway */
+        if (ts <= (int)NodeLimit<uint128_t>::MaxTaskSize)
+        {
+            st.Roots.reserve((ts * (ts - 1) / 2 + 1) * words);
+            st.Heights.reserve(ts * (ts - 1) / 2 + 1);
+        }
+        break;
+    case Engine_OCTAL:
+        st.Literal.resize(GetPackedLiteralSize(ts));
+        st.Sums.resize(in.GroupCount + 1);
+        st.Base.resize(in.GroupCount);
+        st.Pending.resize(in.GroupCount);
+        if (Sink.Enabled) st.SubtreeLiteral.resize(st.Literal.size());
+        break;
+    case Engine_GRAY:
+        st.Index.resize(words + 1);
+        break;
+    default:
+        break;
+    }
+
+    typename FragmentSearch<NodeNumber, Weight>::Entry search;
+    switch (cfg.Engine)
+    {
+    case Engine_STACK: search = SearchFragmentStack<NodeNumber, Weight>; break;
+    case Engine_OCTAL: search = SearchFragmentOctal<NodeNumber, Weight>; break;
+    case Engine_GRAY:  search = SearchFragmentGray<NodeNumber, Weight>;  break;
+    default:           search = PickFragmentSearch(conv, in);            break;
+    }
+
+    /* Count the allocations from here on: the instance is set up */
+    ThreadAllocs = 0;
+    CountingAllocs = cfg.CountAllocs;
+
+    /* Meeting in the middle does not split into node ranges: one worker takes it all */
+    if (cfg.Engine == Engine_MITM || cfg.Engine == Engine_SS)
+    {
+        if (wk->Rank == 0 && cfg.Engine == Engine_MITM) SearchMITM<NodeNumber, Weight>(wk, in);
+        if (wk->Rank == 0 && cfg.Engine == Engine_SS) SearchSS<NodeNumber, Weight>(wk, in);
+        CountingAllocs = false;
+        wk->Allocs = ThreadAllocs;
+        wk->Msec = std::chrono::duration<float, std::milli>(WallClock::now() - clck).count();
+        return;
+    }
+
+    search(wk, in, conv, &st);
+    if (cfg.WorkStealing)
+    {
+        RetireWorker(wk);
+        while (!SearchCancelled() && StealFragment(wk, pool))
+        {
+            /* Re-enter the tree at the start of the stolen range */
+            search(wk, in, conv, &st);
+            RetireWorker(wk);
+        }
+    }
+    CountingAllocs = false;
+    wk->Allocs = ThreadAllocs;
+    wk->Solutions = NodeToZZ(st.Solutions);
+    wk->Visited = NodeToZZ(st.Visited);
+    wk->OverPruned = NodeToZZ(st.OverPruned);
+    wk->BoundPruned = NodeToZZ(st.BoundPruned);
+    wk->LeafResolved = NodeToZZ(st.LeafResolved);
+    wk->GroupSteps = st.GroupSteps;
+    FlushSolutions(wk);
+
+    /* Stop the timer */
+    wk->Msec = std::chrono::duration<float, std::milli>(WallClock::now() - clck).count();
+    return;
+}
+
+template<typename NodeNumber, typename Weight>
+typename FragmentSearch<NodeNumber, Weight>::Entry PickFragmentSearch(const ConverterContext<NodeNumber>&, const SearchInstance<Weight>&)
+{
+    return SearchFragment<NodeNumber, Weight, 0>;
+}
+
+/// Fill the dispatch table with the macro engine instances from TS down to MinFixedTaskSize
+template<typename Weight, int TS> struct FixedSearchTable
+{
+    static void Fill(typename FragmentSearch<uint64_t, Weight>::Entry* table)
+    {
+        table[TS - MinFixedTaskSize] = SearchFragment<uint64_t, Weight, TS>;
+        FixedSearchTable<Weight, TS - 1>::Fill(table);
+    }
+};
+
+template<typename Weight> struct FixedSearchTable<Weight, MinFixedTaskSize - 1>
+{
+    static void Fill(typename FragmentSearch<uint64_t, Weight>::Entry*) { }
+};
+
+FragmentSearch< uint64_t, FixedInt<1> >::Entry PickFragmentSearch(const ConverterContext<uint64_t>& conv, const SearchInstance< FixedInt<1> >&)
+{
+    typedef FragmentSearch< uint64_t, FixedInt<1> >::Entry Entry;
+
+    /* The table is built once, by the first worker to get here */
+    static const std::vector<Entry> table = []()
+    {
+        std::vector<Entry> t(MaxFixedTaskSize - MinFixedTaskSize + 1);
+        FixedSearchTable<FixedInt<1>, MaxFixedTaskSize>::Fill(t.data());
+        return t;
+    }();
+
+    int ts = (int)conv.GetTaskSize();
+    if (ts < MinFixedTaskSize || ts > MaxFixedTaskSize) return SearchFragment<uint64_t, FixedInt<1>, 0>;
+    return table[ts - MinFixedTaskSize];
+}
+
+/// Clamp a branch cut at the current node to the nodes left in the fragment.
+/// A branch running past the fragment end is credited up to the end only: the
+/// nodes beyond belong to the next fragment, which visits or cuts them itself.
+/// @param branch_size Nodes of the branch, its root included;
+/// @param CurrentNode Root of the branch;
+/// @param frag_end    Last node of the fragment;
+/// @return Nodes of the branch up to the fragment end;
+template<typename NodeNumber>
+static inline NodeNumber ClampBranch(const NodeNumber& branch_size, const NodeNumber& CurrentNode, const NodeNumber& frag_end)
+{
+    NodeNumber left = frag_end - CurrentNode;
+    if (left < branch_size) return left + 1;
+    return branch_size;
+}
+
+template<typename NodeNumber, typename Weight, int FixedTaskSize>
+void SearchFragment(Worker* wk, const SearchInstance<Weight>& in, const ConverterContext<NodeNumber>& conv,
+                    SearchState<NodeNumber, Weight>* st)
+{
+    const std::vector<Weight>& knp = in.Knp;
+    const std::vector<Weight>& suffix = in.Suffix;
+    const Weight& w = in.W;
+
+    /* The task size is a constant in the instances picked by PickFragmentSearch() */
+    const int ts = FixedTaskSize ? FixedTaskSize : cfg.TaskSize;
+
+    /* Per-worker data */
+    Weight       c;     //< Buffer for the current packing weight;
+
+    /* Batch of unranked nodes for the non-optimized mode */
+    const unsigned int words = GetPackedMaskSize(ts);
+    uint64_t              fixed_pck[FixedTaskSize ? (FixedTaskSize + 63) / 64 : 1];
+    uint64_t*             pck = FixedTaskSize ? fixed_pck : st->Mask.data(); //< The packed mask of the packing (optimized mode);
+    const uint64_t*       node_mask = pck;                  //< Packed mask of the current node;
+    uint64_t*             batch = st->Batch.data();         //< Packed masks of the batch;
+    Weight*               batch_w = st->BatchWeights.data(); //< Their packing weights;
+    unsigned int          batch_pos = 0, batch_len = 0;    //< Current node in the batch and the batch length;
+    int                   last = -1;                       //< Last item of the current node;
+
+    /* Set the current node to the start of the work area */
+    NodeNumber CurrentNode = NodeFromZZ<NodeNumber>(wk->FragStart);
+    NodeNumber frag_end = NodeFromZZ<NodeNumber>(wk->FragEnd);
+    NodeNumber batch_left;
+
+    /* Buffer for storing the node count in a branch */
+    NodeNumber branch_size; branch_size = 0;
+
+    /* Solution, visited and pruned node counters */
+    NodeNumber solutions; solutions = 0;
+    NodeNumber visited; visited = 0;
+    NodeNumber over_pruned; over_pruned = 0;
+    NodeNumber bound_pruned; bound_pruned = 0;
+
+    /* Buffer for the heaviest packing reachable in a branch */
+    Weight reach;
+
+    /* Reset weight buffer */
+    c = 0;
+    Weight zero; zero = 0;
+
+    if (cfg.OptimizedAlgorithm == true)
+    {
+        GetPackedMaskByRadix(conv, pck, CurrentNode);
+
+        for (int i = ts-1; i>=0; i--)
+            if(GetPackedItem(ts, pck, i))
+            {
+                AddWeight(c, knp[i]);
+            };
+    }
+
+    /* Start the search */
+    while (CurrentNode <= frag_end)
+    {
+        if (SearchCancelled()) break;
+        if (cfg.WorkStealing && wk->StealRequest.load(std::memory_order_relaxed))
+            ShareFragment(wk, CurrentNode, &frag_end);
+        visited++;
+
+        if(cfg.OptimizedAlgorithm == false)
+        {
+            /* Unrank the next run of nodes once the batch is used up */
+            if (batch_pos == batch_len)
+            {
+                batch_left = frag_end - CurrentNode;
+                batch_len = UnrankBatchSize;
+                if (batch_left < long(UnrankBatchSize))
+                {
+                    uint64_t left;
+                    NodeToWords(batch_left, &left, 1);
+                    batch_len = (unsigned int)left + 1;
+                }
+                GetPackedMasksByNumber(conv, batch, CurrentNode, batch_len, knp.data(), batch_w);
+                batch_pos = 0;
+            }
+            c = batch_w[batch_pos];
+            node_mask = batch + batch_pos * words;
+            last = GetLastPackedItem(ts, node_mask);
+        }
+
+        if(c < w && cfg.OptimizedAlgorithm == true && !GetPackedItem(ts, pck, ts-1))
+        {
+            /* Bound the branch by adding all the remaining items at once */
+            int last = GetLastPackedItem(ts, pck);
+            reach = c;
+            AddWeight(reach, suffix[last+1]);
+
+            if(reach < w)
+            {
+                branch_size = ClampBranch(GetPackedSubtreeSize<NodeNumber>(ts, pck), CurrentNode, frag_end);
+                CurrentNode += branch_size;
+                bound_pruned += branch_size - 1;
+                GoSide(knp, pck, c);
+                continue;
+            }
+        }
+
+        if(c < w)
+        {
+            CurrentNode++;
+
+            if (cfg.OptimizedAlgorithm == true)
+            {
+                if (GetPackedItem(ts, pck, ts-1))
+                {
+                    GoBack(knp, pck, c);
+                }
+                else
+                {
+                    GoForward(knp, pck, c);
+                }
+            }
+            else
+            {
+                batch_pos++;
+            }
+        }
+        else if(c > w)
+        {
+            branch_size = ClampBranch(GetPackedSubtreeSize<NodeNumber>(ts, node_mask), CurrentNode, frag_end);
+            CurrentNode += branch_size;
+            over_pruned += branch_size - 1;
+
+            if (cfg.OptimizedAlgorithm == true)
+            {
+                if (GetPackedItem(ts, pck, ts-1))
+                {
+                    GoBack(knp, pck, c);
+                }
+                else
+                {
+                    GoSide(knp, pck, c);
+                }
+            }
+            else
+            {
+                SkipBatch(&batch_pos, batch_len, ts-1-last);
+            }
+        }
+        else if(c == w)
+        {
+            /* A packing ending with a zero weight item does not count: its parent hits w as well. */
+            /* Only the first node of a fragment may be such a packing, the others are cut with the parent */
+            int hit = GetLastPackedItem(ts, node_mask);
+            if (hit < 0 || !(knp[hit] == zero))
+            {
+                solutions++;
+                if (Sink.Enabled) PutSolution(wk, node_mask);
+            }
+            branch_size = ClampBranch(GetPackedSubtreeSize<NodeNumber>(ts, node_mask), CurrentNode, frag_end);
+            CurrentNode += branch_size;
+            over_pruned += branch_size - 1;
+
+            if(cfg.OptimizedAlgorithm == true)
+            {
+                if (GetPackedItem(ts, pck, ts-1))
+                {
+                    GoBack(knp, pck, c);
+                }
+                else
+                {
+                    GoSide(knp, pck, c);
+                }
+            }
+            else
+            {
+                SkipBatch(&batch_pos, batch_len, ts-1-last);
+            }
+        }
+
+    }
+
+    st->Solutions += solutions;
+    st->Visited += visited;
+    st->OverPruned += over_pruned;
+    st->BoundPruned += bound_pruned;
+    return;
+}
+
+template<typename NodeNumber, typename Weight>
+void SearchFragmentStack(Worker* wk, const SearchInstance<Weight>& in, const ConverterContext<NodeNumber>& conv,
+                         SearchState<NodeNumber, Weight>* st)
+{
+    const std::vector<Weight>& knp = in.Knp;
+    const std::vector<Weight>& suffix = in.Suffix;
+    const Weight& w = in.W;
+
+    const int ts = cfg.TaskSize;
+
+    /* Per-worker data */
+    uint64_t*             pck = st->Mask.data();    //< The packed mask of the packing (see converter.h);
+    Weight*               sum = st->Sums.data();    //< sum[d]: weight of the first d items of the packing;
+    int                   depth = 0;                //< Number of items in the packing;
+    int                   last = -1;                //< Last item in the packing (-1 for the root);
+
+    /* Set the current node to the start of the work area */
+    NodeNumber CurrentNode = NodeFromZZ<NodeNumber>(wk->FragStart);
+    NodeNumber frag_end = NodeFromZZ<NodeNumber>(wk->FragEnd);
+
+    /* Node counters */
+    NodeNumber branch_size; branch_size = 0;
+    NodeNumber solutions; solutions = 0;
+    NodeNumber visited; visited = 0;
+    NodeNumber over_pruned; over_pruned = 0;
+    NodeNumber bound_pruned; bound_pruned = 0;
+    NodeNumber leaf_resolved; leaf_resolved = 0;
+
+    /* Buffer for the heaviest packing reachable in a branch */
+    Weight reach;
+    Weight zero; zero = 0;
+
+    /* Leaf block: the node whose last item is leaf_root spans leaf_span descendants */
+    const int leaf_root = cfg.LeafBlock > 0 ? ts - 1 - cfg.LeafBlock : -2;
+    const int leaf_count = 1 << cfg.LeafBlock;
+    NodeNumber leaf_span; leaf_span = leaf_count - 1;
+    uint64_t* found = st->Found.data();         //< Packed mask of a leaf block solution;
+
+    /* Split the fragment into whole subtrees (see SplitNodeRange()): within a
+     * piece the walk ends on leaving its root, with no check of the node number */
+    std::vector<uint64_t>&     roots = st->Roots;       //< Packed masks of the piece roots;
+    std::vector<unsigned int>& heights = st->Heights;   //< Piece heights (0 for a lone node);
+    SplitNodeRange(conv, CurrentNode, frag_end, &roots, &heights);
+    const unsigned int words = GetPackedMaskSize(ts);
+    int  root = 0;      //< Number of items in the piece root;
+    bool lone = false;  //< The piece root is taken without its descendants;
+    bool inside;        //< The walk has not left the piece yet;
+
+    /* Replace the last item with the next one; the prefix below stays intact */
+    #define StackSide() \
+    do { \
+        if (depth == root) { inside = false; break; } \
+        FlipPackedItem(ts, pck, last); \
+        last++; \
+        FlipPackedItem(ts, pck, last); \
+        sum[depth] = sum[depth - 1]; \
+        AddWeight(sum[depth], knp[last]); \
+    } while (0)
+
+    /* Drop the last item of the tree, then step aside from the new last one */
+    #define StackBack() \
+    do { \
+        FlipPackedItem(ts, pck, last); \
+        depth--; \
+        last = GetLastPackedItem(ts, pck); \
+        if (depth < root) { inside = false; break; } \
+        StackSide(); \
+    } while (0)
+
+    for (size_t piece = 0; piece < heights.size(); piece++)
+    {
+        /* Unpack the piece root into the packed mask and the prefix sums */
+        memcpy(pck, &roots[piece * words], words * sizeof(uint64_t));
+        depth = 0;
+        last = -1;
+        sum[0] = 0;
+        for (int i = 0; i < ts; i++)
+            if (GetPackedItem(ts, pck, i))
+            {
+                sum[depth + 1] = sum[depth];
+                AddWeight(sum[depth + 1], knp[i]);
+                depth++;
+                last = i;
+            }
+        root = depth;
+        lone = heights[piece] == 0 && last != ts - 1;
+        inside = true;
+
+        while (inside)
+        {
+            if (SearchCancelled())
+            {
+                piece = heights.size();
+                break;
+            }
+            if (cfg.WorkStealing && wk->StealRequest.load(std::memory_order_relaxed))
+            {
+                /* Split the rest of the shrunk fragment, starting over at the current node */
+                if (ShareFragment(wk, CurrentNode, &frag_end))
+                {
+                    SplitNodeRange(conv, CurrentNode, frag_end, &roots, &heights);
+                    piece = (size_t)-1;
+                    break;
+                }
+            }
+            visited++;
+
+            const Weight& c = sum[depth];
+
+            if (c < w)
+            {
+                if (last == ts - 1)
+                {
+                    CurrentNode++;
+                    StackBack();
+                    continue;
+                }
+
+                if (cfg.OptimizedAlgorithm == true)
+                {
+                    /* Bound the branch by adding all the remaining items at once */
+                    reach = c;
+                    AddWeight(reach, suffix[last + 1]);
+
+                    if (reach < w)
+                    {
+                        branch_size = ClampBranch(PowerOfTwo<NodeNumber>(ts - 1 - last), CurrentNode, frag_end);
+                        CurrentNode += branch_size;
+                        bound_pruned += branch_size - 1;
+                        /* The rest of the fragment lies in the branch of a lone root */
+                        if (lone) piece = heights.size();
+                        StackSide();
+                        continue;
+                    }
+                }
+
+                /* Resolve the leaf block below by one table lookup of w - c */
+                if (last == leaf_root && !lone)
+                {
+                    reach = w;
+                    SubWeight(reach, c);
+                    int hits = CountWeightMatches(in.LeafSums.data(), leaf_count, reach);
+                    solutions += hits;
+                    if (hits && Sink.Enabled)
+                        for (int e = 1; e < leaf_count; e++)
+                            if (in.LeafSums[e] == reach)
+                            {
+                                /* Entry bit j stands for item ts-k+j */
+                                memcpy(found, pck, words * sizeof(uint64_t));
+                                for (int j = 0; j < cfg.LeafBlock; j++)
+                                    if ((e >> j) & 1) FlipPackedItem(ts, found, ts - cfg.LeafBlock + j);
+                                PutSolution(wk, found);
+                            }
+                    branch_size = ClampBranch(leaf_span + 1, CurrentNode, frag_end);
+                    CurrentNode += branch_size;
+                    leaf_resolved += branch_size - 1;
+                    StackSide();
+                    continue;
+                }
+
+                /* Go forward: append the item next to the last one */
+                /* (the first child of a lone root starts the next piece) */
+                CurrentNode++;
+                if (lone) break;
+                last++;
+                FlipPackedItem(ts, pck, last);
+                sum[depth + 1] = c;
+                AddWeight(sum[depth + 1], knp[last]);
+                depth++;
+            }
+            else
+            {
+                /* See SearchFragment(): a packing ending with a zero weight item does not count */
+                if (c == w && (last < 0 || !(knp[last] == zero)))
+                {
+                    solutions++;
+                    if (Sink.Enabled) PutSolution(wk, pck);
+                }
+
+                branch_size = ClampBranch(PowerOfTwo<NodeNumber>(ts - 1 - last), CurrentNode, frag_end);
+                CurrentNode += branch_size;
+                over_pruned += branch_size - 1;
+                if (lone) piece = heights.size();
+
+                if (last == ts - 1) StackBack();
+                else StackSide();
+            }
+        }
+    }
+
+    #undef StackSide
+    #undef StackBack
+
+    st->Solutions += solutions;
+    st->Visited += visited;
+    st->OverPruned += over_pruned;
+    st->BoundPruned += bound_pruned;
+    st->LeafResolved += leaf_resolved;
+    return;
+}
+
+template<typename Weight>
+static void ListSubsetSums(std::vector<Weight>& list, const Weight* items, int count)
+{
+    list.resize(size_t(1) << count);
+    list[0] = 0;
+    for (int i = 0; i < count; i++)
+    {
+        size_t half = size_t(1) << i;
+        for (size_t j = 0; j < half; j++)
+        {
+            list[half + j] = list[j];
+            AddWeight(list[half + j], items[i]);
+        }
+    }
+    return;
+}
+
+template<typename Weight>
+static size_t PartitionCountableSums(std::vector<Weight>& list, std::vector<Weight>& buf, const Weight* items, int count)
+{
+    /* The subsets ending with items[i] are the entries from 2^i up to 2^(i+1) */
+    Weight zero; zero = 0;
+    size_t front = 0, back = 0;
+    for (int i = 0; i < count; i++)
+        if (!(items[i] == zero)) back += size_t(1) << i;
+    const size_t countable = back;
+
+    buf.resize(list.size());
+    buf[back++] = list[0];
+    for (int i = 0; i < count; i++)
+    {
+        size_t half = size_t(1) << i;
+        size_t& to = items[i] == zero ? back : front;
+        std::copy(list.begin() + half, list.begin() + 2 * half, buf.begin() + to);
+        to += half;
+    }
+    list.swap(buf);
+    return countable;
+}
+
+template<typename NodeNumber, typename Weight>
+void SearchFragmentOctal(Worker* wk, const SearchInstance<Weight>& in, const ConverterContext<NodeNumber>& conv,
+                         SearchState<NodeNumber, Weight>* st)
+{
+    const std::vector<Weight>& suffix = in.Suffix;
+    const Weight& w = in.W;
+    const int ts = cfg.TaskSize;
+    const int groups = in.GroupCount;
+    const int pad = in.GroupPad;
+
+    /* Per-worker data */
+    std::vector<uint64_t>& lit = st->Literal;   //< Packed literal string of the current node (group g at level groups-1-g);
+    Weight*               prefix = st->Sums.data(); //< prefix[g]: weight of the groups below g (up to the last one used);
+    Weight*               base = st->Base.data();   //< Subtree counting work area;
+    unsigned*             pending = st->Pending.data(); //< Subtree counting work area;
+    uint64_t*             plit = st->SubtreeLiteral.data(); //< Literal string the subtree solutions are written to;
+    uint64_t*             found = st->Mask.data();  //< Packed mask of a solution (and of the first node);
+
+    /* Set the current node to the start of the work area */
+    NodeNumber CurrentNode = NodeFromZZ<NodeNumber>(wk->FragStart);
+    NodeNumber frag_end = NodeFromZZ<NodeNumber>(wk->FragEnd);
+
+    /* Node counters */
+    NodeNumber branch_size; branch_size = 0;
+    NodeNumber block_limit = PowerOfTwo<NodeNumber>(cfg.WorkStealing || cfg.FirstSolution ? std::min(ts, MaxOctalStealBlock) : ts);
+    NodeNumber solutions; solutions = 0;
+    NodeNumber visited; visited = 0;
+    NodeNumber over_pruned; over_pruned = 0;
+    NodeNumber bound_pruned; bound_pruned = 0;
+    long steps = 0;
+
+    /* Buffer for the heaviest packing reachable in a branch */
+    Weight reach;
+    Weight zero; zero = 0;
+
+    /* The literal string holds the digits of the first node, the last group first */
+    GetPackedMaskByRadix(conv, found, CurrentNode);
+    GetPackedLiteralByPackedMask(ts, lit.data(), found);
+    prefix[0] = 0;
+    for (int g = 0; g < groups; g++)
+    {
+        prefix[g + 1] = prefix[g];
+        AddWeight(prefix[g + 1], in.DigitSums[8*g + GetPackedLiteralDigit(lit.data(), groups - 1 - g)]);
+    }
+
+    /* Step the literal string (see converter.h) and refresh the prefix sums of the */
+    /* groups it touched: those of the added item and of the one before it */
+    #define OctalStep(step) \
+    do { \
+        if (CurrentNode > frag_end) break; \
+        int added = step(ts, lit.data()) + pad; \
+        for (int g = added > 0 ? (added - 1) / 3 : 0; g <= added / 3; g++) \
+        { \
+            prefix[g + 1] = prefix[g]; \
+            AddWeight(prefix[g + 1], in.DigitSums[8*g + GetPackedLiteralDigit(lit.data(), groups - 1 - g)]); \
+        } \
+    } while (0)
+
+    /* Start the search */
+    while (CurrentNode <= frag_end)
+    {
+        if (SearchCancelled()) break;
+        if (cfg.WorkStealing && wk->StealRequest.load(std::memory_order_relaxed))
+            ShareFragment(wk, CurrentNode, &frag_end);
+        visited++;
+
+        /* Position of the last item: its group, bit of the group digit and item index */
+        /* (the root stands right before the first real item of group 0) */
+        int last = GetLastPackedLiteralItem(ts, lit.data());
+        int top = last < 0 ? -1 : (last + pad) / 3;
+        int bit = last < 0 ? pad - 1 : (last + pad) % 3;
+        const Weight& c = prefix[top + 1];
+
+        if (c < w)
+        {
+            if (last == ts - 1)
+            {
+                CurrentNode++;
+                OctalStep(NextPackedLiteral);
+                continue;
+            }
+
+            if (cfg.OptimizedAlgorithm == true)
+            {
+                /* Bound the branch by adding all the remaining items at once */
+                reach = c;
+                AddWeight(reach, suffix[last + 1]);
+
+                if (reach < w)
+                {
+                    branch_size = ClampBranch(PowerOfTwo<NodeNumber>(ts - 1 - last), CurrentNode, frag_end);
+                    CurrentNode += branch_size;
+                    bound_pruned += branch_size - 1;
+                    OctalStep(SkipPackedLiteralBranch);
+                    continue;
+                }
+            }
+
+            /* The last item closes a group: count the groups below digit by digit */
+            branch_size = PowerOfTwo<NodeNumber>(ts - 1 - last);
+            if ((bit == 2 || top < 0) && branch_size <= block_limit && frag_end - CurrentNode >= branch_size - 1)
+            {
+                if (Sink.Enabled)
+                {
+                    memcpy(plit, lit.data(), lit.size() * sizeof(uint64_t));
+                    solutions += CountOctalSubtree(in, top + 1, c, base, pending, &steps,
+                                                   &visited, &over_pruned, &bound_pruned, wk, plit, found);
+                }
+                else solutions += CountOctalSubtree(in, top + 1, c, base, pending, &steps,
+                                                    &visited, &over_pruned, &bound_pruned, (Worker*)0, (uint64_t*)0, (uint64_t*)0);
+                CurrentNode += branch_size;
+                OctalStep(SkipPackedLiteralBranch);
+                continue;
+            }
+
+            /* Go forward: append the item next to the last one */
+            CurrentNode++;
+            OctalStep(NextPackedLiteral);
+        }
+        else
+        {
+            /* See SearchFragment(): a packing ending with a zero weight item does not count */
+            if (c == w && (last < 0 || !(in.Knp[last] == zero)))
+            {
+                solutions++;
+                if (Sink.Enabled)
+                {
+                    SetPackedMaskByPackedLiteral(ts, found, lit.data());
+                    PutSolution(wk, found);
+                }
+            }
+
+            branch_size = ClampBranch(PowerOfTwo<NodeNumber>(ts - 1 - last), CurrentNode, frag_end);
+            CurrentNode += branch_size;
+            over_pruned += branch_size - 1;
+            OctalStep(SkipPackedLiteralBranch);
+        }
+    }
+
+    #undef OctalStep
+
+    st->Solutions += solutions;
+    st->Visited += visited;
+    st->OverPruned += over_pruned;
+    st->BoundPruned += bound_pruned;
+    st->GroupSteps += steps;
+    return;
+}
+
+template<typename NodeNumber, typename Weight>
+static long CountOctalSubtree(const SearchInstance<Weight>& in, int first, const Weight& c, Weight* base, unsigned* pending, long* steps,
+                              NodeNumber* visited, NodeNumber* over_pruned, NodeNumber* bound_pruned,
+                              Worker* wk, uint64_t* plit, uint64_t* found)
+{
+    const int groups = in.GroupCount;
+    long solutions = 0;
+    Weight key, low;
+    NodeNumber below_digit;
+
+    /* Count the digits of the group hitting w exactly, return the ones worth going below. */
+    /* The nonzero digits are the nodes looked at; the nodes below a digit that is not */
+    /* pending are cut: by the weight if the digit reaches w, by the bound otherwise */
+    #define OctalExpand(g) \
+    do { \
+        key = in.W; \
+        SubWeight(key, base[g]); \
+        const Weight* sums = &in.DigitSums[8*(g)]; \
+        unsigned hits = DigitsEqual(sums, key) & in.DigitCountable[g]; \
+        unsigned below = DigitsBelow(sums, key) & in.DigitValid[g]; \
+        *visited += long(__builtin_popcount(in.DigitValid[g]) - 1); \
+        pending[g] = 0; \
+        if ((g) + 1 < groups) \
+        { \
+            pending[g] = below; \
+            if (cfg.OptimizedAlgorithm && in.GroupSuffix[(g) + 1] < key) \
+            { \
+                low = key; \
+                SubWeight(low, in.GroupSuffix[(g) + 1]); \
+                pending[g] &= ~DigitsBelow(sums, low); \
+            } \
+            below_digit = PowerOfTwo<NodeNumber>(3 * (groups - 1 - (g))) - 1; \
+            *over_pruned += below_digit * long(__builtin_popcount(in.DigitValid[g] & ~below)); \
+            *bound_pruned += below_digit * long(__builtin_popcount(below & ~pending[g])); \
+        } \
+        (*steps)++; \
+        solutions += __builtin_popcount(hits); \
+        if (hits && wk) PutOctalSolutions(wk, plit, found, groups - 1 - (g), hits); \
+        if (hits && cfg.FirstSolution) return solutions; \
+    } while (0)
+
+    int g = first;
+    base[g] = c;
+    OctalExpand(g);
+    while (g >= first)
+    {
+        if (pending[g] == 0)
+        {
+            if (wk) SetPackedLiteralDigit(plit, groups - 1 - g, 0);
+            g--;
+            continue;
+        }
+        int d = __builtin_ctz(pending[g]);
+        pending[g] &= pending[g] - 1;
+        if (wk) SetPackedLiteralDigit(plit, groups - 1 - g, d);
+
+        base[g + 1] = base[g];
+        AddWeight(base[g + 1], in.DigitSums[8*g + d]);
+        g++;
+        OctalExpand(g);
+    }
+
+    #undef OctalExpand
+    return solutions;
+}
+
+static void PutOctalSolutions(Worker* wk, uint64_t* plit, uint64_t* found, unsigned int level, unsigned int digits)
+{
+    for (; digits; digits &= digits - 1)
+    {
+        SetPackedLiteralDigit(plit, level, __builtin_ctz(digits));
+        SetPackedMaskByPackedLiteral(cfg.TaskSize, found, plit);
+        PutSolution(wk, found);
+    }
+    SetPackedLiteralDigit(plit, level, 0);
+    return;
+}
+
+template<typename NodeNumber, typename Weight>
+void SearchMITM(Worker* wk, const SearchInstance<Weight>& in)
+{
+    const std::vector<Weight>& knp = in.Knp;
+    const Weight& w = in.W;
+    const int ts = cfg.TaskSize;
+    const int left_size = ts / 2;
+
+    /* Subset sums of both halves. A packing counts when its last item weighs more */
+    /* than zero, so the right list keeps only the subsets ending with such an item */
+    std::vector<Weight> left, right, buf;
+    ListSubsetSums(left, knp.data(), left_size);
+    ListSubsetSums(right, knp.data() + left_size, ts - left_size);
+    size_t left_countable = PartitionCountableSums(left, buf, knp.data(), left_size);
+    right.resize(PartitionCountableSums(right, buf, knp.data() + left_size, ts - left_size));
+
+    /* The packings with no item in the right half: the empty one and the countable left subsets */
+    NodeNumber solutions; solutions = 0;
+    Weight zero; zero = 0;
+    if (w == zero) solutions++;
+    for (size_t k = 0; k < left_countable; k++)
+        if (left[k] == w) solutions++;
+
+    /* Walk the sorted left list up and the sorted right list down, counting equal runs on a match */
+    SortWeights(left, buf);
+    SortWeights(right, buf);
+    NodeNumber run_left, run_right;
+    Weight s;
+    size_t i = 0, j = right.size();
+    while (i < left.size() && j > 0)
+    {
+        s = left[i];
+        AddWeight(s, right[j - 1]);
+
+        if (s < w) i++;
+        else if (s > w) j--;
+        else
+        {
+            run_left = 0;
+            for (size_t k = i; i < left.size() && left[i] == left[k]; i++) run_left++;
+            run_right = 0;
+            for (size_t k = j; j > 0 && right[j - 1] == right[k - 1]; j--) run_right++;
+            solutions += run_left * run_right;
+        }
+    }
+
+    wk->Solutions += NodeToZZ(solutions);
+    NodeNumber visited; visited = long(left.size() + right.size());
+    wk->Visited += NodeToZZ(visited);
+    wk->PeakBytes = (left.capacity() + right.capacity() + buf.capacity()) * sizeof(Weight);
+    return;
+}
+
+/// Cursor of a sum stream: the sum of the first[i] and second[j] list entries
+template<typename Weight>
+struct SumCursor
+{
+    Weight   Sum;
+    unsigned First, Second;
+};
+
+/// Heap order putting the smallest sum on top (ascending stream)
+template<typename Weight>
+struct SmallestOnTop
+{
+    bool operator()(const SumCursor<Weight>& a, const SumCursor<Weight>& b) const { return a.Sum > b.Sum; }
+};
+
+/// Heap order putting the largest sum on top (descending stream)
+template<typename Weight>
+struct LargestOnTop
+{
+    bool operator()(const SumCursor<Weight>& a, const SumCursor<Weight>& b) const { return a.Sum < b.Sum; }
+};
+
+template<typename NodeNumber, typename Weight>
+void SearchSS(Worker* wk, const SearchInstance<Weight>& in)
+{
+    const std::vector<Weight>& knp = in.Knp;
+    const Weight& w = in.W;
+    const int ts = cfg.TaskSize;
+    const int cut[5] = {0, ts / 4, ts / 2, ts / 2 + (ts - ts / 2) / 2, ts};
+
+    /* Subset sums of the quarters, the countable ones (see PartitionCountableSums()) first */
+    std::vector<Weight> quarter[4], countable_b, buf;
+    size_t countable[4];
+    for (int q = 0; q < 4; q++)
+    {
+        ListSubsetSums(quarter[q], knp.data() + cut[q], cut[q + 1] - cut[q]);
+        countable[q] = PartitionCountableSums(quarter[q], buf, knp.data() + cut[q], cut[q + 1] - cut[q]);
+    }
+    std::vector<Weight>& A = quarter[0];
+    std::vector<Weight>& B = quarter[1];
+    std::vector<Weight>& C = quarter[2];
+    std::vector<Weight>& D = quarter[3];
+
+    /* The packings with no item in C or D: the empty one, the countable subsets of A, */
+    /* and any subset of A with a countable subset of B, looked up in their sorted list */
+    NodeNumber solutions; solutions = 0;
+    Weight zero; zero = 0;
+    Weight key;
+    if (w == zero) solutions++;
+    for (size_t k = 0; k < countable[0]; k++)
+        if (A[k] == w) solutions++;
+    countable_b.assign(B.begin(), B.begin() + countable[1]);
+    SortWeights(countable_b, buf);
+    for (size_t k = 0; k < A.size(); k++)
+    {
+        if (w < A[k]) continue;
+        key = w;
+        SubWeight(key, A[k]);
+        solutions += long(std::upper_bound(countable_b.begin(), countable_b.end(), key) -
+                          std::lower_bound(countable_b.begin(), countable_b.end(), key));
+    }
+
+    /* D keeps its countable subsets and the empty one, which sorts first as the others weigh more than zero */
+    D.resize(countable[3]);
+    D.push_back(zero);
+    SortWeights(B, buf);
+    SortWeights(D, buf);
+
+    /* Left stream: a+b ascending, one cursor per entry of A starting at the smallest b */
+    /* Right stream: c+d descending, one cursor per entry of C starting at the largest d; */
+    /* the cursor of a countable c stops at the empty d, the others stop right above it */
+    const size_t right_countable = countable[2];
+    std::vector< SumCursor<Weight> > left_heap(A.size()), right_heap;
+    for (unsigned i = 0; i < A.size(); i++)
+    {
+        left_heap[i].Sum = A[i]; AddWeight(left_heap[i].Sum, B[0]);
+        left_heap[i].First = i; left_heap[i].Second = 0;
+    }
+    right_heap.reserve(C.size());
+    for (unsigned i = 0; i < C.size(); i++)
+    {
+        if (i >= right_countable && D.size() == 1) break;
+        SumCursor<Weight> cur;
+        cur.Sum = C[i]; AddWeight(cur.Sum, D[D.size() - 1]);
+        cur.First = i; cur.Second = (unsigned)D.size() - 1;
+        right_heap.push_back(cur);
+    }
+    size_t peak_bytes = (A.capacity() + B.capacity() + C.capacity() + D.capacity() + countable_b.capacity() + buf.capacity()) * sizeof(Weight)
+                      + (left_heap.capacity() + right_heap.capacity()) * sizeof(SumCursor<Weight>);
+
+    SmallestOnTop<Weight> left_order;
+    LargestOnTop<Weight> right_order;
+    std::make_heap(left_heap.begin(), left_heap.end(), left_order);
+    std::make_heap(right_heap.begin(), right_heap.end(), right_order);
+
+    /* Move the top cursor of a stream to its next sum, dropping it at the end of its row */
+    #define AdvanceLeft() \
+    do { \
+        std::pop_heap(left_heap.begin(), left_heap.end(), left_order); \
+        SumCursor<Weight>& cur = left_heap.back(); \
+        if (++cur.Second < B.size()) \
+        { \
+            cur.Sum = A[cur.First]; AddWeight(cur.Sum, B[cur.Second]); \
+            std::push_heap(left_heap.begin(), left_heap.end(), left_order); \
+        } \
+        else left_heap.pop_back(); \
+        visited++; \
+    } while (0)
+
+    #define AdvanceRight() \
+    do { \
+        std::pop_heap(right_heap.begin(), right_heap.end(), right_order); \
+        SumCursor<Weight>& cur = right_heap.back(); \
+        if (cur.Second-- > (cur.First < right_countable ? 0u : 1u)) \
+        { \
+            cur.Sum = C[cur.First]; AddWeight(cur.Sum, D[cur.Second]); \
+            std::push_heap(right_heap.begin(), right_heap.end(), right_order); \
+        } \
+        else right_heap.pop_back(); \
+        visited++; \
+    } while (0)
+
+    /* Two-pointer merge over the streams, counting equal runs on a match */
+    NodeNumber visited; visited = 0;
+    NodeNumber run_left, run_right;
+    Weight s, value;
+    while (!left_heap.empty() && !right_heap.empty())
+    {
+        s = left_heap.front().Sum;
+        AddWeight(s, right_heap.front().Sum);
+
+        if (s < w) AdvanceLeft();
+        else if (s > w) AdvanceRight();
+        else
+        {
+            run_left = 0;
+            value = left_heap.front().Sum;
+            while (!left_heap.empty() && left_heap.front().Sum == value) { AdvanceLeft(); run_left++; }
+            run_right = 0;
+            value = right_heap.front().Sum;
+            while (!right_heap.empty() && right_heap.front().Sum == value) { AdvanceRight(); run_right++; }
+            solutions += run_left * run_right;
+        }
+    }
+
+    #undef AdvanceLeft
+    #undef AdvanceRight
+
+    wk->Solutions += NodeToZZ(solutions);
+    wk->Visited += NodeToZZ(visited);
+    wk->PeakBytes = peak_bytes;
+    return;
+}
+
+template<typename NodeNumber, typename Weight>
+void SearchFragmentGray(Worker* wk, const SearchInstance<Weight>& in, const ConverterContext<NodeNumber>&,
+                        SearchState<NodeNumber, Weight>* st)
+{
+    const std::vector<Weight>& knp = in.Knp;
+    const Weight& w = in.W;
+    const int ts = cfg.TaskSize;
+    const unsigned int words = GetPackedMaskSize(ts);
+
+    /* Per-worker data */
+    uint64_t* index = st->Index.data();        //< Gray code index of the current packing (one spare word for the carry);
+    uint64_t* gray = st->Mask.data();          //< Its packed mask, index ^ (index >> 1);
+    Weight c; c = 0;                           //< Weight of the current packing;
+    Weight zero; zero = 0;
+
+    /* Set the current index to the start of the work area */
+    NodeNumber CurrentNode = NodeFromZZ<NodeNumber>(wk->FragStart);
+    NodeNumber frag_end = NodeFromZZ<NodeNumber>(wk->FragEnd);
+    NodeNumber left;
+
+    /* Counters */
+    NodeNumber solutions; solutions = 0;
+    NodeNumber visited; visited = 0;
+
+    NodeToWords(CurrentNode, index, words);
+    index[words] = 0;
+    for (unsigned int i = 0; i < words; i++)
+        gray[i] = index[i] ^ (index[i] >> 1) ^ (i + 1 < words ? index[i + 1] << 63 : 0);
+    for (int i = 0; i < ts; i++)
+        if (GetPackedItem(ts, gray, i)) AddWeight(c, knp[i]);
+
+    /* Start the search */
+    while (CurrentNode <= frag_end)
+    {
+        if (SearchCancelled()) break;
+        if (cfg.WorkStealing && wk->StealRequest.load(std::memory_order_relaxed))
+            ShareFragment(wk, CurrentNode, &frag_end);
+
+        /* Take a run of indices short enough to look at the fragment end again soon */
+        uint64_t run = GrayRun;
+        left = frag_end - CurrentNode;
+        if (left < long(GrayRun))
+        {
+            NodeToWords(left, &run, 1);
+            run++;
+        }
+
+        for (uint64_t k = 0; k < run; k++)
+        {
+            if (c == w)
+            {
+                int last = GetLastPackedItem(ts, gray);
+                if (last < 0 || !(knp[last] == zero))
+                {
+                    solutions++;
+                    if (Sink.Enabled) PutSolution(wk, gray);
+                }
+            }
+
+            /* Step to the next index: the lowest set bit of it names the item to flip */
+            unsigned int b = 0, i = 0;
+            while (++index[i] == 0) { b += 64; i++; }
+            b += __builtin_ctzll(index[i]);
+            if (b >= (unsigned int)ts) break;   /* Past the last packing */
+            gray[b >> 6] ^= 1ULL << (b & 63);
+            if ((gray[b >> 6] >> (b & 63)) & 1) AddWeight(c, knp[ts - 1 - b]);
+            else SubWeight(c, knp[ts - 1 - b]);
+        }
+
+        CurrentNode += long(run);
+        visited += long(run);
+    }
+
+    st->Solutions += solutions;
+    st->Visited += visited;
+    return;
+}
+
+/// Answer the waiting thief; a granted thief has its fragment bounds set already.
+/// Lock order is always victim first, thief second, PoolLock last.
+static void AnswerThief(Worker* wk, bool grant)
+{
+    Worker* thief = wk->Thief;
+    std::lock_guard<std::mutex> guard(thief->Lock);
+
+    if (grant)
+    {
+        thief->Busy = true;
+        std::lock_guard<std::mutex> pool(PoolLock);
+        BusyWorkers++;
+        PoolGeneration++;
+        PoolChanged.notify_all();
+    }
+    thief->Answer = grant ? 1 : 0;
+
+    wk->Thief = 0;
+    wk->StealRequest = false;
+    thief->Answered.notify_one();
+    return;
+}
+
+template<typename NodeNumber>
+bool ShareFragment(Worker* wk, const NodeNumber& CurrentNode, NodeNumber* frag_end)
+{
+    std::lock_guard<std::mutex> guard(wk->Lock);
+    NodeNumber rest = *frag_end - CurrentNode + 1;
+    bool grant = rest >= long(MinStealSize);
+    if (grant)
+    {
+        /* The thief waits for the answer, so nobody else reads its bounds meanwhile */
+        Worker* thief = wk->Thief;
+        thief->FragEnd = wk->FragEnd;
+        *frag_end -= rest / 2;
+        NodeToZZ(wk->FragEnd, *frag_end);
+        rest = *frag_end + 1;
+        NodeToZZ(thief->FragStart, rest);
+    }
+    AnswerThief(wk, grant);
+    return grant;
+}
+
+void RetireWorker(Worker* wk)
+{
+    {
+        std::lock_guard<std::mutex> guard(wk->Lock);
+        wk->Busy = false;
+        if (wk->Thief) AnswerThief(wk, false);
+    }
+    std::lock_guard<std::mutex> pool(PoolLock);
+    BusyWorkers--;
+    PoolGeneration++;
+    PoolChanged.notify_all();
+    return;
+}
+
+bool StealFragment(Worker* wk, std::vector<Worker>* pool)
+{
+    int count = (int)pool->size();
+
+    while (BusyWorkers.load() > 0)
+    {
+        unsigned long seen;
+        {
+            std::lock_guard<std::mutex> guard(PoolLock);
+            seen = PoolGeneration;
+        }
+        for (int k = 1; k < count; k++)
+        {
+            Worker* victim = &(*pool)[(wk->Rank + k) % count];
+            {
+                std::lock_guard<std::mutex> guard(victim->Lock);
+                if (!victim->Busy || victim->Thief) continue;
+                wk->Answer = -1;
+                victim->Thief = wk;
+                victim->StealRequest = true;
+            }
+
+            std::unique_lock<std::mutex> own(wk->Lock);
+            while (wk->Answer < 0) wk->Answered.wait(own);
+            if (wk->Answer == 1)
+            {
+                wk->Steals++;
+                return true;
+            }
+        }
+
+        /* Every busy worker refused or had a thief already: their fragments only
+         * shrink until the next split or retirement, so wait for one of those */
+        std::unique_lock<std::mutex> guard(PoolLock);
+        while (PoolGeneration == seen && BusyWorkers.load() > 0) PoolChanged.wait(guard);
+    }
+    return false;
+}
+
+void SkipBatch(unsigned int* pos, unsigned int len, int exp)
+{
+    if (exp < 32 && (1ull << exp) < len - *pos) *pos += 1u << exp;
+    else *pos = len;
+}
+
+/* Converter Self-Test
+ *
+ * The node number conversions of converter.h are checked against the literal
+ * string functions the tree search started with, in every node number type:
+ * on every node of the task sizes up to SelfTestExhaustiveSize, and above it
+ * on the nodes around the powers of two, the first and last ones and random
+ * ones (NTL::ZZ takes one task size in SelfTestStride there, up to
+ * SelfTestMaxSize). Each check counts its passes and failures; the first
+ * failures are printed with the task size and node number. --self-test-all
+ * checks the packed mask rank and unrank on every node up to SelfTestFullSize
+ * instead, which takes a long time. */
+
+/// Checks of the self-test
+enum SelfTestCheck
+{
+    Check_LITERAL_RANK,     ///< GetNumberByLiteralString() undoes GetLiteralStringByNumber();
+    Check_MASK_PACKING,     ///< UnpackMask() undoes PackMask();
+    Check_PACKED_UNRANK,    ///< GetPackedMaskByNumber() gives the mask of the literal string;
+    Check_PACKED_RANK,      ///< GetNumberByPackedMask() gives the node number back;
+    Check_BATCH_UNRANK,     ///< GetPackedMasksByNumber() gives the masks and weights of the nodes from the given one;
+    Check_PACKED_STEP,      ///< NextPackedMask() gives the mask of the next node and the items it flips;
+    Check_LITERAL_STEP,     ///< NextLiteral() gives the literal string of the next node, GetLastLiteralItem() its last item;
+    Check_LITERAL_SKIP,     ///< SkipLiteralBranch() gives the literal string of the node past the branch;
+    Check_LITERAL_ADVANCE,  ///< AdvanceLiteral() gives the literal string of the node the given distance ahead;
+    Check_PACKED_SKIP,      ///< SkipPackedBranch() gives the mask of the node past the branch;
+    Check_SPLIT_RANGE,      ///< SplitNodeRange() covers the range from the node with whole subtrees, one after another;
+    Check_DOMAIN_LEVELS,    ///< A context shares the DomainLevels below its top, equal in every node number type;
+    Check_RADIX_UNRANK,     ///< GetRadixStringByNumber() and GetPackedMaskByRadix() give the radix string and the packed mask;
+    Check_RADIX_RANK,       ///< GetNumberByRadixString() gives the node number back;
+    Check_PLIT_PACKING,     ///< PackLiteralString() keeps the digits of the literal string, UnpackLiteralString() gives it back;
+    Check_PLIT_MASKS,       ///< The packed literal string converts to and from the packed mask and the binary vector;
+    Check_PLIT_RANK,        ///< GetPackedLiteralByNumber() and GetNumberByPackedLiteral() undo each other;
+    Check_PLIT_STEP,        ///< NextPackedLiteral() and SkipPackedLiteralBranch() give the next node and the node past the branch;
+    Check_PLIT_ADVANCE,     ///< AdvancePackedLiteral() gives the packed literal string of the node the given distance ahead;
+    Check_SUBTREE_SIZE,     ///< GetSubtreeSizeByNumber() and GetNextSiblingByNumber() agree with the packed mask of the node;
+    Check_COUNT
+};
+
+/// Check names for the report
+const char* SelfTestNames[Check_COUNT] = {"literal rank", "mask packing", "packed unrank", "packed rank", "batch unrank",
+                                          "packed step", "literal step", "literal skip", "literal advance",
+                                          "packed skip", "split range", "domain levels", "radix unrank", "radix rank",
+                                          "plit packing", "plit masks", "plit rank", "plit step", "plit advance",
+                                          "subtree size"};
+
+/// Pass and fail counts of every check
+unsigned long SelfTestPassed[Check_COUNT], SelfTestFailed[Check_COUNT];
+
+/// Task sizes up to this one are tested on every node
+const unsigned int SelfTestExhaustiveSize = 16;
+/// Task sizes up to this one are tested on every node by --self-test-all
+const unsigned int SelfTestFullSize = 30;
+
+/// Number of failures printed in full
+const unsigned long SelfTestReportedFailures = 20;
+
+/// Random nodes tested per task size and node number type above SelfTestExhaustiveSize
+const unsigned int SelfTestSamples = 200;
+/// Number of nodes unranked at once by the batch check
+const unsigned int SelfTestBatch = 5;
+/// Largest task size tested with NTL::ZZ node numbers
+const unsigned int SelfTestMaxSize = 200;
+/// Step between the task sizes tested with NTL::ZZ node numbers above SelfTestExhaustiveSize
+const unsigned int SelfTestStride = 23;
+
+/// Count the outcome of a check on a node, printing the first failures
+template<typename NodeNumber>
+static void SelfTestExpect(SelfTestCheck check, bool ok, unsigned int ts, const NodeNumber& number)
+{
+    if (ok) { SelfTestPassed[check]++; return; }
+    unsigned long failed = 0;
+    for (int c = 0; c < Check_COUNT; c++) failed += SelfTestFailed[c];
+    SelfTestFailed[check]++;
+    if (failed >= SelfTestReportedFailures) return;
+    std::ostringstream str;
+    str << NodeToZZ(number);
+    printf("FAILED %s: n = %u, node %s (%u-bit node numbers)\n", SelfTestNames[check], ts, str.str().c_str(),
+           (unsigned int)(8 * sizeof(NodeNumber)));
+}
+
+/// Buffers of the node checks for one task size
+template<typename NodeNumber>
+struct SelfTestBuffers
+{
+    NodeNumber              Last;       ///< The last node of the tree, 2^n - 1;
+    std::vector<NTL::ZZ>    Items;      ///< Random Knapsack vector weighing the batches;
+    std::vector<NTL::ZZ>    Weights;    ///< Weights of the batch;
+    std::vector<uint64_t>   Batch;      ///< Packed masks of the batch;
+    std::vector<DomainType> Lit;        ///< Literal string of the node;
+    std::vector<DomainType> Lit2;       ///< Work area;
+    std::vector<DomainType> Lit3;       ///< Work area;
+    NTL::vec_GF2            Mask;       ///< Binary vector of the node (from its literal string);
+    NTL::vec_GF2            Mask2;      ///< Work area;
+    std::vector<uint64_t>   Packed;     ///< Packed mask of the node (from its binary vector);
+    std::vector<uint64_t>   Packed2;    ///< Work area;
+    std::vector<uint64_t>   Roots;      ///< Subtree roots of a split range;
+    std::vector<unsigned int> Heights;  ///< Their subtree heights;
+    std::vector< std::unique_ptr< ConverterContext<NodeNumber> > > Radix; ///< Contexts of every radix digit width, the narrowest first;
+    unsigned int            RadixNext;  ///< Digit width the next node is checked with, minus one;
+    std::vector<uint16_t>   Digits;     ///< Radix string of the node;
+    std::vector<uint16_t>   Digits2;    ///< Work area;
+    std::vector<uint64_t>   PLit;       ///< Packed literal string of the node (from its literal string);
+    std::vector<uint64_t>   PLit2;      ///< Work area;
+    std::vector<uint64_t>   PLit3;      ///< Work area;
+};
+
+/// Run all the checks on a node
+template<typename NodeNumber>
+static void SelfTestNode(const ConverterContext<NodeNumber>& ctx, SelfTestBuffers<NodeNumber>& b, const NodeNumber& number)
+{
+    const unsigned int ts = ctx.GetTaskSize();
+    const unsigned int words = GetPackedMaskSize(ts);
+    NodeNumber next;
+
+    /* The reference: the literal string and the binary vector it stands for */
+    GetLiteralStringByNumber(ctx, b.Lit.data(), number);
+    SelfTestExpect(Check_LITERAL_RANK, GetNumberByLiteralString(ctx, b.Lit.data()) == number, ts, number);
+    SetMaskByLiteralString(ts, &b.Mask, b.Lit.data());
+    PackMask(ts, b.Packed.data(), b.Mask);
+    UnpackMask(ts, &b.Mask2, b.Packed.data());
+    SelfTestExpect(Check_MASK_PACKING, b.Mask2 == b.Mask, ts, number);
+
+    /* Packed masks */
+    GetPackedMaskByNumber(ts, b.Packed2.data(), number);
+    SelfTestExpect(Check_PACKED_UNRANK, b.Packed2 == b.Packed, ts, number);
+    SelfTestExpect(Check_PACKED_RANK, GetNumberByPackedMask<NodeNumber>(ts, b.Packed.data()) == number, ts, number);
+
+    /* Batch unranking, up to the last node */
+    unsigned int count = 1;
+    for (next = number; count < SelfTestBatch && next < b.Last; count++) next += 1;
+    GetPackedMasksByNumber(ctx, b.Batch.data(), number, count, b.Items.data(), b.Weights.data());
+    bool ok = true;
+    next = number;
+    for (unsigned int j = 0; j < count; j++, next += 1)
+    {
+        NTL::ZZ weight(0);
+        GetPackedMaskByNumber(ts, b.Packed2.data(), next);
+        for (unsigned int i = 0; i < ts; i++)
+            if (GetPackedItem(ts, b.Packed2.data(), i)) weight += b.Items[i];
+        ok = ok && !memcmp(&b.Batch[j * words], b.Packed2.data(), words * sizeof(uint64_t)) && b.Weights[j] == weight;
+    }
+    SelfTestExpect(Check_BATCH_UNRANK, ok, ts, number);
+
+    /* One step: the added item becomes the last one; a step back drops item n-1 and the one before the added item */
+    if (number < b.Last)
+    {
+        int dropped;
+        memcpy(b.Packed2.data(), b.Packed.data(), words * sizeof(uint64_t));
+        int added = NextPackedMask(ts, b.Packed2.data(), &dropped);
+        ok = !memcmp(b.Packed2.data(), &b.Batch[words], words * sizeof(uint64_t)) && GetLastPackedItem(ts, b.Packed2.data()) == added &&
+             (dropped < 0 || (dropped == (int)ts - 1 && GetPackedItem(ts, b.Packed.data(), dropped) &&
+                              GetPackedItem(ts, b.Packed.data(), added - 1) && !GetPackedItem(ts, b.Packed2.data(), added - 1)));
+        SelfTestExpect(Check_PACKED_STEP, ok, ts, number);
+    }
+
+    /* Literal string stepping: one step, a branch skip and jumps ahead */
+    int last_item = GetLastPackedItem(ts, b.Packed.data());
+    if (number < b.Last)
+    {
+        b.Lit2 = b.Lit;
+        int added = NextLiteral(ts, b.Lit2.data());
+        next = number + 1;
+        GetLiteralStringByNumber(ctx, b.Lit3.data(), next);
+        SelfTestExpect(Check_LITERAL_STEP, b.Lit2 == b.Lit3 && GetLastLiteralItem(ts, b.Lit.data()) == last_item &&
+                                           GetLastLiteralItem(ts, b.Lit2.data()) == added, ts, number);
+    }
+    if (last_item >= 0)
+    {
+        next = number + PowerOfTwo<NodeNumber>(ts - 1 - last_item);
+        if (next <= b.Last)
+        {
+            b.Lit2 = b.Lit;
+            SkipLiteralBranch(ts, b.Lit2.data());
+            GetLiteralStringByNumber(ctx, b.Lit3.data(), next);
+            SelfTestExpect(Check_LITERAL_SKIP, b.Lit2 == b.Lit3, ts, number);
+        }
+    }
+    NodeNumber distance[3];
+    distance[0] = 0;
+    distance[1] = (b.Last - number) >> 1;
+    distance[2] = b.Last - number;
+    ok = true;
+    for (int d = 0; d < 3; d++)
+    {
+        b.Lit2 = b.Lit;
+        AdvanceLiteral(ts, b.Lit2.data(), distance[d]);
+        next = number + distance[d];
+        GetLiteralStringByNumber(ctx, b.Lit3.data(), next);
+        ok = ok && b.Lit2 == b.Lit3;
+    }
+    SelfTestExpect(Check_LITERAL_ADVANCE, ok, ts, number);
+
+    /* Packed branch skip */
+    if (last_item >= 0)
+    {
+        next = number + PowerOfTwo<NodeNumber>(ts - 1 - last_item);
+        if (next <= b.Last)
+        {
+            memcpy(b.Packed2.data(), b.Packed.data(), words * sizeof(uint64_t));
+            int added = SkipPackedBranch(ts, b.Packed2.data());
+            SelfTestExpect(Check_PACKED_SKIP, GetNumberByPackedMask<NodeNumber>(ts, b.Packed2.data()) == next &&
+                                              GetLastPackedItem(ts, b.Packed2.data()) == added, ts, number);
+        }
+    }
+
+    /* Split the range up to half way to the last node: the pieces follow each other, */
+    /* a piece of height h > 0 being the whole subtree of its root */
+    NodeNumber end = number + distance[1];
+    SplitNodeRange(ctx, number, end, &b.Roots, &b.Heights);
+    ok = b.Heights.size() <= ts * (ts - 1) / 2 + 1;
+    next = number;
+    for (size_t piece = 0; ok && piece < b.Heights.size(); piece++)
+    {
+        const uint64_t* root = &b.Roots[piece * words];
+        unsigned int h = b.Heights[piece];
+        ok = GetNumberByPackedMask<NodeNumber>(ts, root) == next && (h == 0 || (int)h == (int)ts - 1 - GetLastPackedItem(ts, root));
+        next += PowerOfTwo<NodeNumber>(h);
+    }
+    SelfTestExpect(Check_SPLIT_RANGE, ok && next == end + 1, ts, number);
+
+    /* Radix strings, one digit width per node in turn */
+    const ConverterContext<NodeNumber>& rctx = *b.Radix[b.RadixNext];
+    const unsigned int k = rctx.GetRadixBits(), digits = rctx.GetRadixStringSize();
+    b.RadixNext = (b.RadixNext + 1) % MaxRadixBits;
+    GetRadixStringByNumber(rctx, b.Digits.data(), b.Packed2.data(), number);
+    ok = b.Packed2 == b.Packed;
+    GetPackedMaskByRadix(rctx, b.Packed2.data(), number);
+    ok = ok && b.Packed2 == b.Packed;
+    SetPackedMaskByRadixString(ts, k, b.Packed2.data(), b.Digits.data());
+    GetRadixStringByPackedMask(ts, k, b.Digits2.data(), b.Packed.data());
+    SelfTestExpect(Check_RADIX_UNRANK, ok && b.Packed2 == b.Packed && !memcmp(b.Digits.data(), b.Digits2.data(), digits * sizeof(uint16_t)), ts, number);
+    SelfTestExpect(Check_RADIX_RANK, GetNumberByRadixString(rctx, b.Digits.data()) == number, ts, number);
+
+    /* Packed literal strings: the digits, with the two sentinels past them when unpacked */
+    const unsigned int length = GetPackedLiteralLength(ts);
+    PackLiteralString(ts, b.PLit.data(), b.Lit.data());
+    UnpackLiteralString(ts, b.Lit2.data(), b.PLit.data());
+    ok = std::equal(b.Lit.begin(), b.Lit.begin() + length + 2, b.Lit2.begin());
+    std::fill(b.PLit2.begin(), b.PLit2.end(), 0);
+    for (unsigned int l = 0; l < length; l++)
+    {
+        ok = ok && GetPackedLiteralDigit(b.PLit.data(), l) == (unsigned int)b.Lit[l + 1];
+        SetPackedLiteralDigit(b.PLit2.data(), l, b.Lit[l + 1]);
+    }
+    SelfTestExpect(Check_PLIT_PACKING, ok && b.PLit2 == b.PLit, ts, number);
+    SetPackedMaskByPackedLiteral(ts, b.Packed2.data(), b.PLit.data());
+    ok = b.Packed2 == b.Packed;
+    GetPackedLiteralByPackedMask(ts, b.PLit2.data(), b.Packed.data());
+    ok = ok && b.PLit2 == b.PLit;
+    SetMaskByPackedLiteral(ts, &b.Mask2, b.PLit.data());
+    GetPackedLiteralByMask(ts, b.PLit2.data(), b.Mask);
+    SelfTestExpect(Check_PLIT_MASKS, ok && b.Mask2 == b.Mask && b.PLit2 == b.PLit, ts, number);
+    GetPackedLiteralByNumber(ctx, b.PLit2.data(), number);
+    SelfTestExpect(Check_PLIT_RANK, b.PLit2 == b.PLit && GetNumberByPackedLiteral(ctx, b.PLit.data()) == number &&
+                                    GetLastPackedLiteralItem(ts, b.PLit.data()) == last_item, ts, number);
+    if (number < b.Last)
+    {
+        b.PLit2 = b.PLit;
+        int added = NextPackedLiteral(ts, b.PLit2.data());
+        GetPackedLiteralByPackedMask(ts, b.PLit3.data(), &b.Batch[words]);
+        ok = b.PLit2 == b.PLit3 && GetLastPackedLiteralItem(ts, b.PLit2.data()) == added;
+        if (last_item >= 0)
+        {
+            next = number + PowerOfTwo<NodeNumber>(ts - 1 - last_item);
+            if (next <= b.Last)
+            {
+                b.PLit2 = b.PLit;
+                added = SkipPackedLiteralBranch(ts, b.PLit2.data());
+                GetPackedLiteralByNumber(ctx, b.PLit3.data(), next);
+                ok = ok && b.PLit2 == b.PLit3 && GetLastPackedLiteralItem(ts, b.PLit2.data()) == added;
+            }
+        }
+        SelfTestExpect(Check_PLIT_STEP, ok, ts, number);
+    }
+    ok = true;
+    for (int d = 0; d < 3; d++)
+    {
+        b.PLit2 = b.PLit;
+        AdvancePackedLiteral(ts, b.PLit2.data(), distance[d]);
+        next = number + distance[d];
+        GetPackedLiteralByNumber(ctx, b.PLit3.data(), next);
+        ok = ok && b.PLit2 == b.PLit3;
+    }
+    SelfTestExpect(Check_PLIT_ADVANCE, ok, ts, number);
+
+    /* Subtree size and the next sibling from the node number alone */
+    NodeNumber size = GetPackedSubtreeSize<NodeNumber>(ts, b.Packed.data());
+    next = GetNextSiblingByNumber(ts, number);
+    SelfTestExpect(Check_SUBTREE_SIZE, GetSubtreeSizeByNumber(ts, number) == size && next == number + size &&
+                                       next == GetNextSiblingByPackedMask(ts, b.Packed.data(), number), ts, number);
+}
+
+/// Check the collapse levels of a context against the shared DomainLevels and an NTL::ZZ context of the task size
+template<typename NodeNumber>
+static void SelfTestLevels(const ConverterContext<NodeNumber>& ctx)
+{
+    const unsigned int ts = ctx.GetTaskSize();
+    const unsigned int depth = GetMaxDomainDepth(ts);
+    ConverterContext<NTL::ZZ> ref(ts);
+    bool ok = true;
+    for (unsigned int l = 0; l <= depth; l++)
+    {
+        const NodeNumber* level = ctx.GetDomainLevel(l);
+        if (l < depth) ok = ok && level == DomainLevels<NodeNumber>::GetLevel(l);
+        for (unsigned int k = 0; k < DomainStride; k++)
+        {
+            ok = ok && NodeToZZ(level[k]) == ref.GetDomainLevel(l)[k];
+            if (l < depth && l <= MaxNativeDomainLevel) ok = ok && NodeToZZ(ctx.GetNativeLevel(l)[k]) == NodeToZZ(level[k]);
+        }
+    }
+    NodeNumber zero; zero = 0;
+    SelfTestExpect(Check_DOMAIN_LEVELS, ok, ts, zero);
+}
+
+/// Run the node checks over a task size in the given node number type
+template<typename NodeNumber>
+static void SelfTestTaskSize(unsigned int ts, std::mt19937_64& rng)
+{
+    ConverterContext<NodeNumber> ctx(ts);
+    SelfTestLevels(ctx);
+    const unsigned int words = GetPackedMaskSize(ts);
+    SelfTestBuffers<NodeNumber> b;
+    b.Items.resize(ts);
+    for (unsigned int i = 0; i < ts; i++) b.Items[i] = NTL::ZZ((long)(rng() >> 1));
+    b.Weights.resize(SelfTestBatch);
+    b.Batch.resize(SelfTestBatch * words);
+    b.Lit.resize(ts / 3 + 4);
+    b.Lit2.resize(b.Lit.size());
+    b.Lit3.resize(b.Lit.size());
+    b.Mask.SetLength(ts);
+    b.Mask2.SetLength(ts);
+    b.Packed.resize(words);
+    b.Packed2.resize(words);
+    for (unsigned int k = 1; k <= MaxRadixBits; k++) b.Radix.emplace_back(new ConverterContext<NodeNumber>(ts, k));
+    b.RadixNext = 0;
+    b.Digits.resize(ts);
+    b.Digits2.resize(ts);
+    b.PLit.resize(GetPackedLiteralSize(ts));
+    b.PLit2.resize(b.PLit.size());
+    b.PLit3.resize(b.PLit.size());
+
+    NodeNumber number, one;
+    one = 1;
+    b.Last = PowerOfTwo<NodeNumber>(ts) - one;
+    const NodeNumber& last = b.Last;
+    if (ts <= SelfTestExhaustiveSize)
+    {
+        for (number = 0; number <= last; number += one) SelfTestNode(ctx, b, number);
+        return;
+    }
+
+    /* The first and last nodes, and the ones around the subtree sizes */
+    number = 0;
+    SelfTestNode(ctx, b, number);
+    for (unsigned int h = 0; h < ts; h++)
+    {
+        number = PowerOfTwo<NodeNumber>(h);
+        SelfTestNode(ctx, b, number);
+        SelfTestNode(ctx, b, NodeNumber(number - one));
+        SelfTestNode(ctx, b, NodeNumber(number + one));
+        SelfTestNode(ctx, b, NodeNumber(last - number + one));
+    }
+    SelfTestNode(ctx, b, last);
+
+    /* Random nodes */
+    std::vector<uint64_t> random(words);
+    for (unsigned int k = 0; k < SelfTestSamples; k++)
+    {
+        for (unsigned int i = 0; i < words; i++) random[i] = rng();
+        if (ts % 64) random[words - 1] &= (1ULL << (ts % 64)) - 1;
+        number = NodeFromWords<NodeNumber>(random.data(), words);
+        SelfTestNode(ctx, b, number);
+    }
+}
+
+/// Check the packed mask rank and unrank on every node of a task size against the literal strings (uint64_t node numbers)
+static void SelfTestAllNodes(unsigned int ts)
+{
+    ConverterContext<uint64_t> ctx(ts);
+    std::vector<DomainType> lit(ts / 3 + 4);
+    NTL::vec_GF2 mask;
+    mask.SetLength(ts);
+    uint64_t packed, packed2;
+    const uint64_t last = PowerOfTwo<uint64_t>(ts) - 1;
+    for (uint64_t number = 0; number <= last; number++)
+    {
+        GetLiteralStringByNumber(ctx, lit.data(), number);
+        SetMaskByLiteralString(ts, &mask, lit.data());
+        PackMask(ts, &packed, mask);
+        GetPackedMaskByNumber(ts, &packed2, number);
+        SelfTestExpect(Check_PACKED_UNRANK, packed2 == packed, ts, number);
+        SelfTestExpect(Check_PACKED_RANK, GetNumberByPackedMask<uint64_t>(ts, &packed) == number, ts, number);
+    }
+}
+
+int RunSelfTest(bool all)
+{
+    std::mt19937_64 rng(1);
+    for (int c = 0; c < Check_COUNT; c++) SelfTestPassed[c] = SelfTestFailed[c] = 0;
+
+    if (all)
+        for (unsigned int ts = 3; ts <= SelfTestFullSize; ts++) SelfTestAllNodes(ts);
+    else
+    {
+        /* A context built first keeps its levels while the larger task sizes grow the shared table */
+        ConverterContext<NTL::ZZ> early(SelfTestExhaustiveSize);
+        SelfTestLevels(early);
+
+        for (unsigned int ts = 3; ts <= NodeLimit<uint64_t>::MaxTaskSize; ts++) SelfTestTaskSize<uint64_t>(ts, rng);
+        for (unsigned int ts = 3; ts <= NodeLimit<uint128_t>::MaxTaskSize; ts++) SelfTestTaskSize<uint128_t>(ts, rng);
+        for (unsigned int ts = 3; ts <= SelfTestMaxSize; ts += ts < SelfTestExhaustiveSize ? 1 : SelfTestStride)
+            SelfTestTaskSize<NTL::ZZ>(ts, rng);
+        SelfTestLevels(early);
+    }
+
+    unsigned long failed = 0;
+    printf("Check          |Passed     |Failed     |\n");
+    printf("---------------x-----------x-----------x\n");
+    for (int c = 0; c < Check_COUNT; c++)
+    {
+        printf("%-15s|%11lu|%11lu|\n", SelfTestNames[c], SelfTestPassed[c], SelfTestFailed[c]);
+        failed += SelfTestFailed[c];
+    }
+    printf("%s\n", failed ? "Self-test FAILED;" : "Self-test passed;");
+    return failed ? 1 : 0;
 }